@@ -101,12 +101,10 @@ class upper_command : public command
   public:
   explicit upper_command( const environment::ptr& env ) : command( env, "changes string to upper case" )
   {
+    add_rule( has_store_element<std::string>( env ) );
 
-  }
-
-  rules validity_rules() const
-  {
-    return {has_store_element<std::string>( env )};
+    reads_store<std::string>();
+    writes_store<std::string>();
   }
 
   void execute()
@@ -116,7 +114,9 @@ class upper_command : public command
   }
 };
 
-ALICE_ADD_COMMAND( upper, "Manipulation" )
+/* upper is pure, but since it changes the element that it reads, its
+   executions are never replayed from the cache */
+ALICE_PURE_COMMAND( upper, "Manipulation" )
 
 }
 
@@ -104,7 +104,7 @@ void show<int>( std::ostream& os, const int& element, const command& cmd )
 showpage
   )ps";
 
-  const auto fontsize = cmd.option_value<unsigned>( "--fontsize", 30 );
+  const auto fontsize = cmd.find_option<unsigned>( "--fontsize" ).value_or( 30 );
   os << fmt::format( ps, fontsize, element );
 }
 
@@ -32,11 +32,16 @@
 
 #pragma once
 
+#include <array>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
 #include <fmt/format.h>
 
+#include "detail/command_table.hpp"
 #include "detail/python.hpp"
 #include "detail/utils.hpp"
 #include "cli.hpp"
@@ -288,6 +293,43 @@ inline bool can_write<type, io_##tag##_tag_t>( command& ) { return true; } \
 template<> \
 inline void write<type, io_##tag##_tag_t>( type const& element, const std::string& filename, const command& cmd )
 
+/*! \brief Read from a stream into a store
+
+  Like ``ALICE_READ_FILE`` but reads from an input stream.  It is used, if
+  ``read_<tag>`` is called without filename after a pipe, e.g., in
+  ``write_<tag> | read_<tag>``.  It must be used together with
+  ``ALICE_READ_FILE`` for the same type and tag.
+
+  The macro must be followed by a code block.
+
+  \param type Store type
+  \param tag File tag
+  \param is Input stream
+  \param cmd Reference to the command line interface of the command
+*/
+#define ALICE_READ_STREAM(type, tag, is, cmd) \
+template<> \
+inline type read<type, io_##tag##_tag_t>( std::istream& is, const command& cmd )
+
+/*! \brief Write from a store into a stream
+
+  Like ``ALICE_WRITE_FILE`` but writes into an output stream.  It is used for
+  ``write_<tag> --log`` and if the output of ``write_<tag>`` is passed to the
+  next command with ``|``.  It must be used together with ``ALICE_WRITE_FILE``
+  for the same type and tag.
+
+  The macro must be followed by a code block.
+
+  \param type Store type
+  \param tag File tag
+  \param element Reference to the store element
+  \param os Output stream
+  \param cmd Reference to the command line interface of the command
+*/
+#define ALICE_WRITE_STREAM(type, tag, element, os, cmd) \
+template<> \
+inline void write<type, io_##tag##_tag_t>( type const& element, std::ostream& os, const command& cmd )
+
 /*! \brief Registers a file type to alice
 
   Calling this macro will mainly cause the addition of two commands
@@ -301,6 +343,8 @@ inline void write<type, io_##tag##_tag_t>( type const& element, const std::strin
 #define ALICE_ADD_FILE_TYPE(tag, name) \
 struct io_##tag##_tag_t \
 { \
+  static constexpr const char* read_command = "read_" #tag; \
+  static constexpr const char* write_command = "write_" #tag; \
   io_##tag##_tag_t() \
   { \
     if ( std::find( alice_globals::get().read_tags.begin(), alice_globals::get().read_tags.end(), #tag ) != alice_globals::get().read_tags.end() ) return; \
@@ -324,6 +368,7 @@ _ALICE_ADD_TO_LIST(alice_write_tags, io_##tag##_tag_t)
 #define ALICE_ADD_FILE_TYPE_READ_ONLY(tag, name) \
 struct io_##tag##_tag_t \
 { \
+  static constexpr const char* read_command = "read_" #tag; \
   io_##tag##_tag_t() \
   { \
     if ( std::find( alice_globals::get().read_tags.begin(), alice_globals::get().read_tags.end(), #tag ) != alice_globals::get().read_tags.end() ) return; \
@@ -344,6 +389,7 @@ _ALICE_ADD_TO_LIST(alice_read_tags, io_##tag##_tag_t)
 #define ALICE_ADD_FILE_TYPE_WRITE_ONLY(tag, name) \
 struct io_##tag##_tag_t \
 { \
+  static constexpr const char* write_command = "write_" #tag; \
   io_##tag##_tag_t() \
   { \
     if ( std::find( alice_globals::get().write_tags.begin(), alice_globals::get().write_tags.end(), #tag ) != alice_globals::get().write_tags.end() ) return; \
@@ -428,6 +474,14 @@ std::string html_repr<type>( type const& element )
 ////////////////////////////////////////////////////////////////////////////////
 // commands
 
+/*! \cond PRIVATE */
+/* commands that are declared pure, specialized by ALICE_PURE_COMMAND */
+template<typename Command>
+struct is_pure_command : std::false_type
+{
+};
+/*! \endcond */
+
 template<typename CLI, typename Tuple, std::size_t Index>
 struct insert_commands
 {
@@ -436,8 +490,17 @@ struct insert_commands
     insert_commands<CLI, Tuple, Index - 1> ic( cli );
 
     using command_type = std::tuple_element_t<Index - 1, Tuple>;
+    /* the factory is owned by the environment and must not keep it alive */
+    auto factory = [env = std::weak_ptr<environment>( cli.env )]() -> std::shared_ptr<command> {
+      auto cmd = std::make_shared<command_type>( env.lock() );
+      if constexpr ( is_pure_command<command_type>::value )
+      {
+        cmd->set_pure();
+      }
+      return cmd;
+    };
     cli.set_category( alice_globals::get().command_names[Index - 1].second );
-    cli.insert_command( alice_globals::get().command_names[Index - 1].first, std::make_shared<command_type>( cli.env ) );
+    cli.insert_command( alice_globals::get().command_names[Index - 1].first, factory(), factory );
   }
 };
 
@@ -449,6 +512,44 @@ struct insert_commands<CLI, Tuple, 0>
   }
 };
 
+/*! \cond PRIVATE */
+/* command names that are known at compile time, specialized by the macros */
+template<typename Command>
+struct command_name;
+
+template<typename CLI, typename... C, typename... R, typename... W>
+constexpr auto make_command_names( std::tuple<C...>*, std::tuple<R...>*, std::tuple<W...>* )
+{
+  constexpr auto num_builtin = CLI::builtin_command_names.size();
+  std::array<std::string_view, num_builtin + sizeof...( C ) + sizeof...( R ) + sizeof...( W )> names{};
+  std::array<std::string_view, sizeof...( C ) + sizeof...( R ) + sizeof...( W )> added = {
+      std::string_view( command_name<C>::value )...,
+      std::string_view( R::read_command )...,
+      std::string_view( W::write_command )...};
+
+  for ( std::size_t i = 0u; i < num_builtin; ++i )
+  {
+    names[i] = CLI::builtin_command_names[i];
+  }
+  for ( std::size_t i = 0u; i < added.size(); ++i )
+  {
+    names[num_builtin + i] = added[i];
+  }
+  return names;
+}
+
+#define _ALICE_COMMAND_TABLE(cli, cli_t) \
+  static constexpr auto alice_command_table = detail::make_perfect_hash( make_command_names<cli_t>( static_cast<alice_commands*>( nullptr ), static_cast<alice_read_tags*>( nullptr ), static_cast<alice_write_tags*>( nullptr ) ) ); \
+  cli.set_command_table( alice_command_table );
+
+#define _ALICE_COMMAND_NAME(name) \
+template<> \
+struct command_name<name##_command> \
+{ \
+  static constexpr const char* value = #name; \
+};
+/*! \endcond */
+
 #define _ALICE_COMMAND_INIT(name, category) \
 struct name##_command_init \
 { \
@@ -475,6 +576,7 @@ name##_command_init _##name##_command_init;
 #define ALICE_COMMAND(name, category, description) \
 _ALICE_COMMAND_INIT(name, category) \
 class name##_command; \
+_ALICE_COMMAND_NAME(name) \
 _ALICE_ADD_TO_LIST(alice_commands, name##_command) \
 class name##_command : public command \
 { \
@@ -499,8 +601,28 @@ void name##_command::execute()
  */
 #define ALICE_ADD_COMMAND(name, category) \
 _ALICE_COMMAND_INIT(name, category) \
+_ALICE_COMMAND_NAME(name) \
 _ALICE_ADD_TO_LIST(alice_commands, name##_command)
 
+/*! \brief Add a pure command
+
+  Like ``ALICE_ADD_COMMAND``, but declares the command as pure, i.e., its
+  result only depends on its arguments and on the current elements of the
+  stores it reads.  The stores that the command reads and writes must be
+  declared in its constructor using ``reads_store`` and ``writes_store``.
+  Repeated executions with the same arguments and unchanged input stores are
+  replayed from a cache.
+
+  \param name Name of the command
+  \param category Category of the command (as shown in ``help``)
+ */
+#define ALICE_PURE_COMMAND(name, category) \
+ALICE_ADD_COMMAND(name, category) \
+template<> \
+struct is_pure_command<name##_command> : std::true_type \
+{ \
+};
+
 /*! \cond PRIVATE */
 #define ALICE_INIT \
 _ALICE_START_LIST( alice_stores ) \
@@ -520,7 +642,8 @@ _ALICE_START_LIST( alice_write_tags )
   \
   insert_read_commands<cli_t, alice_read_tags, std::tuple_size<alice_read_tags>::value> irc( cli ); \
   insert_write_commands<cli_t, alice_write_tags, std::tuple_size<alice_write_tags>::value> iwc( cli ); \
-  insert_commands<cli_t, alice_commands, std::tuple_size<alice_commands>::value> ic( cli );
+  insert_commands<cli_t, alice_commands, std::tuple_size<alice_commands>::value> ic( cli ); \
+  _ALICE_COMMAND_TABLE( cli, cli_t )
 /*! \endcond */
 
 #if defined ALICE_PYTHON
@@ -552,6 +675,7 @@ extern "C" { \
     insert_read_commands<cli_t, alice_read_tags, std::tuple_size<alice_read_tags>::value> irc( *cli ); \
     insert_write_commands<cli_t, alice_write_tags, std::tuple_size<alice_write_tags>::value> iwc( *cli ); \
     insert_commands<cli_t, alice_commands, std::tuple_size<alice_commands>::value> ic( *cli ); \
+    _ALICE_COMMAND_TABLE( (*cli), cli_t ) \
     return reinterpret_cast<void*>( cli ); \
   } \
   \
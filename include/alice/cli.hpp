@@ -32,24 +32,41 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <fstream>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <regex>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <CLI11.hpp>
 #include <fmt/format.h>
 
 #include "command.hpp"
+#include "detail/command_cache.hpp"
+#include "detail/command_table.hpp"
+#include "detail/interpolation.hpp"
+#include "detail/line_reader.hpp"
 #include "detail/logging.hpp"
+#include "detail/lru_cache.hpp"
+#include "detail/mapped_file.hpp"
+#include "detail/pipe.hpp"
+#include "detail/script.hpp"
 #include "readline.hpp"
 
 #include "commands/alias.hpp"
 #include "commands/convert.hpp"
 #include "commands/current.hpp"
+#include "commands/foreach.hpp"
 #include "commands/help.hpp"
+#include "commands/jobs.hpp"
 #include "commands/print.hpp"
 #include "commands/ps.hpp"
 #include "commands/quit.hpp"
@@ -72,6 +89,10 @@ template<class... S>
 class cli
 {
 public:
+  /*! \brief Names of the commands that are added by the constructor */
+  static constexpr std::array<std::string_view, 14u> builtin_command_names = {
+      "alias", "help", "jobs", "kill", "quit", "set", "wait", "convert", "current", "foreach", "print", "ps", "show", "store"};
+
   /*! \brief Default constructor
 
     Initializes the CLI with a prefix that is used as a command prefix in
@@ -94,17 +115,21 @@ public:
     set_category( "General" );
     insert_command( "alias", std::make_shared<alias_command>( env ) );
     insert_command( "help", std::make_shared<help_command>( env ) );
+    insert_command( "jobs", std::make_shared<jobs_command>( env ) );
+    insert_command( "kill", std::make_shared<kill_command>( env ) );
     insert_command( "quit", std::make_shared<quit_command>( env ) );
     insert_command( "set", std::make_shared<set_command>( env ) );
+    insert_command( "wait", std::make_shared<wait_command>( env ) );
 
     if ( sizeof...( S ) )
     {
-      insert_command( "convert", std::make_shared<convert_command<S...>>( env ) );
-      insert_command( "current", std::make_shared<current_command<S...>>( env ) );
-      insert_command( "print", std::make_shared<print_command<S...>>( env ) );
-      insert_command( "ps", std::make_shared<ps_command<S...>>( env ) );
-      insert_command( "show", std::make_shared<show_command<S...>>( env ) );
-      insert_command( "store", std::make_shared<store_command<S...>>( env ) );
+      insert_command_type<convert_command<S...>>( "convert" );
+      insert_command_type<current_command<S...>>( "current" );
+      insert_command_type<foreach_command<S...>>( "foreach" );
+      insert_command_type<print_command<S...>>( "print" );
+      insert_command_type<ps_command<S...>>( "ps" );
+      insert_command_type<show_command<S...>>( "show" );
+      insert_command_type<store_command<S...>>( "store" );
     }
 
     opts->add_option( "-c,--command", command, "process semicolon-separated list of commands" );
@@ -113,6 +138,7 @@ public:
     opts->add_flag( "-n,--counter", "show a counter in the prefix" );
     opts->add_flag( "-i,--interactive", "continue in interactive mode after processing commands (in command or file mode)" );
     opts->add_option( "-l,--log", logname, "logs the execution and stores many statistical information" );
+    opts->add_flag( "--json", "write the log and the output of each command as one JSON object per line" );
   }
 
   /*! \brief Sets the current category
@@ -147,6 +173,59 @@ public:
   {
     env->_categories[category].push_back( name );
     env->_commands[name] = cmd;
+    dispatch.update( name, cmd.get() );
+  }
+
+  /*! \brief Inserts a command with a factory
+
+    Like the other method, but also registers a factory to create further
+    instances of the command, which are needed to run the command on several
+    threads at the same time (e.g., in ``foreach --jobs``).
+
+    \param name Name of the command
+    \param cmd Shared pointer to a command instance
+    \param factory Function that creates a new command instance
+  */
+  void insert_command( const std::string& name, const std::shared_ptr<command>& cmd, std::function<std::shared_ptr<command>()> factory )
+  {
+    insert_command( name, cmd );
+    env->_command_factories[name] = std::move( factory );
+  }
+
+  /*! \brief Inserts a command by its type
+
+    Constructs the command from the environment and additional arguments, and
+    registers a factory that creates further instances in the same way.
+
+    \param name Name of the command
+    \param args Additional constructor arguments
+  */
+  template<typename Command, typename... Args>
+  void insert_command_type( const std::string& name, Args const&... args )
+  {
+    /* the factory is owned by env and must not keep it alive */
+    auto factory = [env = std::weak_ptr<environment>( env ), args...]() -> std::shared_ptr<alice::command> { return std::make_shared<Command>( env.lock(), args... ); };
+    insert_command( name, factory(), factory );
+  }
+
+  /*! \brief Sets a perfect hash table for command lookup
+
+    The table is computed at compile time from all command names that are
+    known statically, e.g., using ``detail::make_perfect_hash``.  The macro
+    :c:macro:`ALICE_MAIN` does this automatically for all commands that are
+    added with the macro API.  Commands whose name is not part of the table are
+    still found by a regular lookup in the environment.
+
+    \param table Perfect hash table of command names
+  */
+  template<std::size_t N>
+  void set_command_table( detail::perfect_hash<N> const& table )
+  {
+    dispatch.assign( table );
+    for ( const auto& p : env->_commands )
+    {
+      dispatch.update( p.first, p.second.get() );
+    }
   }
 
   /*! \brief Inserts a read command
@@ -162,7 +241,7 @@ public:
   template<typename Tag>
   void insert_read_command( const std::string& name, const std::string& label )
   {
-    insert_command( name, std::make_shared<read_io_command<Tag, S...>>( env, label ) );
+    insert_command_type<read_io_command<Tag, S...>>( name, label );
   }
 
   /*! \brief Inserts a write command
@@ -178,7 +257,7 @@ public:
   template<typename Tag>
   void insert_write_command( const std::string& name, const std::string& label )
   {
-    insert_command( name, std::make_shared<write_io_command<Tag, S...>>( env, label ) );
+    insert_command_type<write_io_command<Tag, S...>>( name, label );
   }
 
   /*! \brief Runs the shell
@@ -202,11 +281,13 @@ public:
     catch ( const CLI::CallForHelp& e )
     {
       env->out() << opts->help();
+      env->flush();
       return 1;
     }
     catch ( const CLI::ParseError& e )
     {
-      env->out() << "[e] " << e.what() << std::endl;
+      env->print( "[e] {}\n", e.what() );
+      env->flush();
       return 2;
     }
 
@@ -218,22 +299,45 @@ public:
       env->logger.start( logname );
     }
 
-    if ( opts->count( "-c" ) )
+    if ( opts->count( "--json" ) )
+    {
+      env->_json = true;
+    }
+
+    if ( opts->count( "-c" ) && detail::has_block( command ) )
+    {
+      /* blocks may span several commands */
+      if ( opts->count( "-e" ) )
+      {
+        env->print( "{}{}\n", get_prefix(), command );
+      }
+      if ( !execute_line( command ) )
+      {
+        env->flush();
+        return 1;
+      }
+
+      env->_categories.clear();
+      env->_commands.clear();
+      env->_command_factories.clear();
+      dispatch.clear();
+    }
+    else if ( opts->count( "-c" ) )
     {
-      auto split = detail::split_with_quotes<';'>( command );
+      detail::line_tokenizer tokenizer;
+      tokenizer.tokenize( command );
 
-      std::string batch_string;
-      std::string abc_opts;
-      for ( auto& line : split )
+      for ( const auto& part : tokenizer.commands() )
       {
-        detail::trim( line );
+        const std::string line( part.text );
 
         if ( opts->count( "-e" ) )
         {
-          env->out() << get_prefix() << line << std::endl;
+          env->print( "{}{}\n", get_prefix(), line );
         }
         if ( !execute_line( preprocess_alias( line ) ) )
         {
+          env->flush();
           return 1;
         }
 
@@ -246,6 +350,8 @@ public:
       // cleanup to prevent memory leak
       env->_categories.clear();
       env->_commands.clear();
+      env->_command_factories.clear();
+      dispatch.clear();
     }
     else if ( opts->count( "-f" ) )
     {
@@ -259,22 +365,45 @@ public:
 
     if ( ( !opts->count( "-c" ) && !opts->count( "-f" ) ) || ( !env->quit && opts->count( "-i" ) ) )
     {
-      auto& rl = readline_wrapper::instance();
-      rl.init( env );
-
-      std::string line;
-      while ( !env->quit && rl.read_command_line( get_prefix(), line ) )
+      if ( !detail::is_terminal( stdin ) )
+      {
+        /* no prompts and no history for input that is piped into the shell */
+        process_stream( stdin, opts->count( "-e" ) );
+      }
+      else
       {
-        execute_line( preprocess_alias( line ) );
-        rl.add_to_history( line );
+        auto& rl = readline_wrapper::instance();
+        rl.init( env );
+
+        std::string line;
+        env->flush();
+        while ( !env->quit && rl.read_command_line( get_prefix(), line ) )
+        {
+          /* read lines until all blocks are closed */
+          std::string next;
+          while ( detail::open_blocks( line ) > 0 && rl.read_command_line( "... ", next ) )
+          {
+            line += '\n' + next;
+          }
+
+          execute_line( detail::has_block( line ) ? line : preprocess_alias( line ) );
+          rl.add_to_history( line );
+          report_jobs();
+          env->flush();
+        }
       }
     }
 
+    /* the shell stops after all background jobs have finished */
+    env->_jobs.wait_all();
+    report_jobs();
+
     if ( env->log )
     {
       env->logger.stop();
     }
 
+    env->flush();
     return 0;
   }
 
@@ -290,175 +419,1472 @@ private:
       return false;
     }
 
-    /* split commands if line contains a semi-colon */
-    const auto lines = detail::split_with_quotes<';'>( line );
+    if ( detail::has_block( line ) )
+    {
+      return execute_block( line );
+    }
+
+    /* one tokenizer per recursion level, such that tokens stay valid */
+    if ( tokenizers.size() <= depth )
+    {
+      tokenizers.push_back( std::make_unique<detail::line_tokenizer>() );
+    }
+
+    ++depth;
+    const auto result = execute_tokenized_line( line, *tokenizers[depth - 1u] );
+    --depth;
+
+    return result;
+  }
+
+  /* compiles lines with blocks into a script and executes it, returns false
+     if the lines contain errors or one of their commands failed */
+  bool execute_block( const std::string& text )
+  {
+    detail::script script;
+    detail::script_location location{std::make_shared<const std::string>( "command line" ), 0u};
+
+    detail::for_each_line( script.store( text ), [&]( std::string_view line ) {
+      ++location.line;
+      compile_statements( detail::trim_view( line ), location, script );
+    } );
+    close_open_blocks( 0u, script );
+
+    auto succeeded = false;
+    execute_script( script, false, &succeeded );
+    return succeeded;
+  }
+
+  bool execute_tokenized_line( const std::string& line, detail::line_tokenizer& tokenizer )
+  {
+    tokenizer.tokenize( line );
+    const auto& commands = tokenizer.commands();
+
+    if ( commands.empty() )
+    {
+      return false;
+    }
 
     /* if more than one command is detected recurse on each part */
-    if ( lines.size() > 1u )
+    if ( commands.size() > 1u )
     {
       auto result = true;
 
-      for ( const auto& cline : lines )
+      for ( const auto& part : commands )
       {
-        result = result && execute_line( preprocess_alias( cline ) );
+        result = result && execute_line( preprocess_alias( std::string( part.text ) ) );
       }
 
       return result;
     }
 
+    const auto& part = commands.front();
+
     /* escape to shell */
-    if ( line[0] == '!' )
+    if ( part.text.front() == '!' )
     {
-      const auto now = std::chrono::system_clock::now();
-      const auto result = detail::execute_program( line.substr( 1u ) );
+      std::string cmdline( part.text.substr( 1u ) );
+      if ( detail::has_variables( cmdline ) )
+      {
+        detail::interpolation( cmdline ).evaluate( env->_variables, cmdline, true );
+      }
+      return execute_shell( cmdline, line );
+    }
 
-      env->out() << result.second;
+    /* read commands from file */
+    if ( part.text.front() == '<' )
+    {
+      process_file( std::string( detail::trim_view( part.text.substr( 1u ) ) ), opts->count( "-e" ) );
+      return true;
+    }
 
-      if ( !result.second.empty() && result.second.back() != '\n' )
+    /* run in the background */
+    if ( detail::is_job( tokenizer.begin( part ), tokenizer.end( part ) ) )
+    {
+      detail::interpolated_arguments variables;
+      if ( detail::has_variables( part.text ) )
       {
-        env->out() << '%' << std::endl;
+        variables.compile( tokenizer.begin( part ), tokenizer.end( part ) - 1 );
       }
+      return start_job( tokenizer.begin( part ), tokenizer.end( part ) - 1, line, variables );
+    }
 
-      if ( env->log )
+    const auto pipe = detail::has_pipe( part.text, tokenizer.begin( part ), tokenizer.end( part ) );
+
+    /* substitute variables */
+    if ( detail::has_variables( part.text ) )
+    {
+      detail::interpolated_arguments variables;
+      if ( variables.compile( tokenizer.begin( part ), tokenizer.end( part ) ) )
       {
-        nlohmann::json log = {{"status", result.first}, {"output", result.second}};
-        env->logger.log( log, line, now );
+        return execute_interpolated( variables, nullptr, tokenizer.begin( part ), tokenizer.end( part ), line, pipe );
       }
+    }
 
-      return true;
+    /* connect commands with pipes */
+    if ( pipe )
+    {
+      return execute_pipeline( tokenizer.begin( part ), tokenizer.end( part ), tokenizer.begin( part ), line );
     }
 
-    /* read commands from file */
-    if ( line[0] == '<' )
+    const auto name = tokenizer.tokens()[part.first];
+
+    if ( auto* cmd = find_command( name ) )
     {
-      auto filename = line.substr( 1u );
-      detail::trim( filename );
-      process_file( filename, opts->count( "-e" ) );
-      return true;
+      return execute_command( cmd, tokenizer.begin( part ), tokenizer.end( part ), line );
     }
+    else
+    {
+      env->err() << "[e] unknown command: " << name << std::endl;
+      return false;
+    }
+  }
+
+  /* executes a command after substituting variables in its arguments, the
+     command is looked up after substitution if cmd is nullptr */
+  template<typename Iterator>
+  bool execute_interpolated( detail::interpolated_arguments const& variables, alice::command* cmd, Iterator begin, Iterator end, std::string_view line, bool pipe = false )
+  {
+    std::vector<std::string> values;
+    std::vector<std::string_view> args;
+    variables.evaluate( begin, end, env->_variables, values, args );
+
+    if ( pipe )
+    {
+      return execute_pipeline( args.begin(), args.end(), begin, line );
+    }
+
+    if ( !cmd && !( cmd = find_command( args.front() ) ) )
+    {
+      env->err() << "[e] unknown command: " << args.front() << std::endl;
+      return false;
+    }
+
+    return execute_command( cmd, args.begin(), args.end(), line );
+  }
 
-    auto vline = detail::split_with_quotes<' '>( line );
+  /* executes commands that are connected with `|`
 
-    const auto it = env->commands().find( vline.front() );
-    if ( it != env->commands().end() )
+     Each command writes into `env->pipe_output()`, which is the input of the
+     next command in `env->pipe_input()`.  The data is passed in memory and a
+     command is only executed if the previous one succeeded.  The operators are
+     located in the tokens before substitution, such that variables whose
+     value is `|` do not split the line. */
+  template<typename Iterator, typename TokenIterator>
+  bool execute_pipeline( Iterator begin, Iterator end, TokenIterator tokens, std::string_view line )
+  {
+    std::unique_ptr<detail::pipe_buffer> input, output;
+    std::istream is( nullptr );
+    std::ostream os( nullptr );
+
+    auto result = true;
+    for ( auto first = begin; result; )
     {
-      const auto now = std::chrono::system_clock::now();
-      const auto result = it->second->run( vline );
+      auto last = first;
+      while ( last != end && *( tokens + ( last - begin ) ) != "|" )
+      {
+        ++last;
+      }
 
-      if ( result && env->log )
+      auto* cmd = first == last ? nullptr : find_command( *first );
+      if ( !cmd )
       {
-        env->logger.log( it->second->log(), line, now );
+        env->err() << ( first == last ? "[e] missing command in pipe" : fmt::format( "[e] unknown command: {}", *first ) ) << std::endl;
+        result = false;
+        break;
       }
 
-      return result;
+      output = last == end ? nullptr : std::make_unique<detail::pipe_buffer>();
+      is.rdbuf( input.get() );
+      os.rdbuf( output.get() );
+      env->_pipe_in = input ? &is : nullptr;
+      env->_pipe_out = output ? &os : nullptr;
+
+      result = execute_command( cmd, first, last, line ) && ( !output || !os.bad() );
+
+      if ( last == end )
+      {
+        break;
+      }
+      input = std::move( output );
+      first = last + 1;
+    }
+
+    env->_pipe_in = nullptr;
+    env->_pipe_out = nullptr;
+    return result;
+  }
+
+  bool execute_shell( const std::string& cmdline, std::string_view line )
+  {
+    const auto now = std::chrono::system_clock::now();
+    const auto result = detail::execute_program( cmdline );
+
+    if ( env->_json )
+    {
+      write_json_line( {{"status", result.first}, {"output", result.second}}, line, true, {}, {} );
     }
     else
     {
-      env->err() << "[e] unknown command: " << vline.front() << std::endl;
-      return false;
+      env->out() << result.second;
+
+      if ( !result.second.empty() && result.second.back() != '\n' )
+      {
+        env->print( "%\n" );
+      }
+    }
+
+    if ( env->log )
+    {
+      nlohmann::json log = {{"status", result.first}, {"output", result.second}};
+      env->logger.log( log, std::string( line ), now );
     }
 
+    env->command_finished();
     return true;
   }
 
-  bool process_file( const std::string& filename, bool echo, bool error_on_not_found = true )
+  template<typename Iterator>
+  bool execute_command( alice::command* cmd, Iterator begin, Iterator end, std::string_view line )
+  {
+    if ( env->_json )
+    {
+      return execute_json( cmd, begin, end, line );
+    }
+
+    nlohmann::json log;
+    const auto result = run_command( cmd, begin, end, line, log );
+    env->command_finished();
+    report_jobs();
+    return result;
+  }
+
+  /* runs a command and sets log to its log, if the command succeeded and the
+     log is needed */
+  template<typename Iterator>
+  bool run_command( alice::command* cmd, Iterator begin, Iterator end, std::string_view line, nlohmann::json& log )
   {
-    std::ifstream in( filename.c_str(), std::ifstream::in );
+    const auto now = std::chrono::system_clock::now();
+
+    /* the output into a pipe is not recorded */
+    const auto pure = cmd->is_pure() && !env->_pipe_in && !env->_pipe_out;
+    const auto result = pure ? execute_pure_command( cmd, begin, end, line, now, log ) : cmd->run_tokens( begin, end );
 
-    if ( !in.good() )
+    if ( result && !pure && ( env->log || env->_json ) )
     {
-      if ( error_on_not_found )
+      log = cmd->log();
+    }
+
+    if ( result && env->log && !pure )
+    {
+      env->logger.log( log, std::string( line ), now );
+    }
+
+    return result;
+  }
+
+  /* runs a command and writes its log together with its output and errors
+     as one JSON line, nothing else is written */
+  template<typename Iterator>
+  bool execute_json( alice::command* cmd, Iterator begin, Iterator end, std::string_view line )
+  {
+    auto& out = *env->_out_sink.target();
+    auto& err = *env->_err_sink.target();
+    std::ostringstream out_buffer, err_buffer;
+
+    nlohmann::json log;
+    env->reroute( out_buffer, err_buffer );
+    auto result = false;
+    try
+    {
+      result = run_command( cmd, begin, end, line, log );
+    }
+    catch ( ... )
+    {
+      env->reroute( out, err );
+      throw;
+    }
+    env->reroute( out, err );
+
+    write_json_line( std::move( log ), line, result, out_buffer.str(), err_buffer.str() );
+    env->command_finished();
+    report_jobs();
+    return result;
+  }
+
+  /* starts a command on a worker thread, the command needs a factory such
+     that the job has its own instance of it, and it writes into buffers that
+     are shown by `report_jobs` after it has finished */
+  template<typename Iterator>
+  bool start_job( Iterator begin, Iterator end, std::string_view line, detail::interpolated_arguments const& variables )
+  {
+    std::vector<std::string> args;
+    if ( variables.empty() )
+    {
+      args.assign( begin, end );
+    }
+    else
+    {
+      std::vector<std::string> values;
+      std::vector<std::string_view> views;
+      variables.evaluate( begin, end, env->_variables, values, views );
+      args.assign( views.begin(), views.end() );
+    }
+
+    if ( args.empty() )
+    {
+      env->err() << "[e] missing command before &" << std::endl;
+      return false;
+    }
+    if ( std::find( args.begin(), args.end(), "|" ) != args.end() )
+    {
+      env->err() << "[e] commands connected with pipes cannot run in the background" << std::endl;
+      return false;
+    }
+
+    auto cmd = env->create_command( args.front() );
+    if ( !cmd )
+    {
+      env->err() << fmt::format( find_command( args.front() ) ? "[e] command {} cannot run in the background" : "[e] unknown command: {}", args.front() ) << std::endl;
+      return false;
+    }
+
+    /* a command that does not declare its stores may access all of them */
+    if ( cmd->store_dependencies.empty() )
+    {
+      []( ... ) {}( ( cmd->writes_store<S>(), 0 )... );
+    }
+
+    const std::string text( detail::trim_view( line.substr( 0u, line.rfind( '&' ) ) ) );
+    const auto& job = env->_jobs.start( text, std::move( cmd ), std::move( args ), []( detail::job& job ) {
+      detail::thread_context context;
+      context.worker = true;
+      context.out = &job.out;
+      context.err = &job.err;
+      context.cancelled = &job.cancelled;
+      detail::thread_context_guard guard( context );
+
+      try
       {
-        env->out() << "[e] file " << filename << " not found" << std::endl;
+        job.result = job.cmd->run_tokens( job.args.begin(), job.args.end() );
       }
-      return true;
+      catch ( const std::exception& e )
+      {
+        job.err << "[e] " << e.what() << std::endl;
+      }
+
+      if ( job.result )
+      {
+        job.log = job.cmd->log();
+      }
+    } );
+
+    if ( env->_json )
+    {
+      write_json_line( {{"job", job.id}}, line, true, {}, {} );
+    }
+    else
+    {
+      env->print( "[i] job {} started: {}\n", job.id, job.line );
     }
+    env->command_finished();
+    return true;
+  }
 
-    std::string line;
+  /* shows the output of jobs that have finished and logs them with their
+     start and finish times */
+  void report_jobs()
+  {
+    if ( env->_jobs.empty() )
+    {
+      return;
+    }
 
-    while ( getline( in, line ) )
+    for ( const auto& job : env->_jobs.take_finished() )
     {
-      detail::trim( line );
+      const auto status = job->cancelled ? "killed" : ( job->result ? "done" : "failed" );
 
-      if ( echo )
+      if ( env->_json )
       {
-        env->out() << get_prefix() << line << std::endl;
+        auto log = job->log.is_object() ? job->log : nlohmann::json::object();
+        log["job"] = job->id;
+        log["status"] = status;
+        log["start"] = detail::logger::format_time( job->start );
+        log["finish"] = detail::logger::format_time( job->finish );
+        write_json_line( std::move( log ), job->line, job->result, job->out.str(), job->err.str() );
+      }
+      else
+      {
+        env->print( "[i] job {} {}: {}\n", job->id, status, job->line );
+        env->out() << job->out.str();
+        env->err() << job->err.str();
       }
 
-      execute_line( preprocess_alias( line ) );
-
-      if ( env->quit )
+      if ( job->result && env->log )
       {
-        /* quit */
-        return true;
+        auto log = job->log;
+        log["job"] = job->id;
+        env->logger.log( log, job->line, job->start, job->finish );
       }
     }
 
-    /* do not quit */
-    return false;
+    env->command_finished();
   }
 
-  std::string get_prefix()
+  /* writes a JSON object with the entries of log (in the format of `-l`), the
+     command, whether it succeeded, and its output and errors, if any */
+  void write_json_line( nlohmann::json log, std::string_view line, bool result, std::string const& output, std::string const& errors )
   {
-    std::string r = prefix;
+    if ( log.is_null() )
+    {
+      log = nlohmann::json::object();
+    }
+    else if ( !log.is_object() )
+    {
+      log = {{"log", std::move( log )}};
+    }
 
-    if ( env->has_default_option() )
+    log["command"] = std::string( line );
+    log["success"] = result;
+    if ( !output.empty() && !log.contains( "output" ) )
     {
-      r += fmt::format( " [{}]", env->default_option() );
+      log["output"] = output;
     }
-    if ( opts->count( "-n" ) )
+    if ( !errors.empty() )
     {
-      r += fmt::format( " {}", counter++ );
+      log["errors"] = errors;
     }
-    return r + "> ";
+
+    env->print( "{}\n", log.dump( -1, ' ', false, nlohmann::json::error_handler_t::replace ) );
   }
 
-  void read_aliases()
+  /* replays a pure command from the cache, if arguments and versions of the stores it reads match */
+  template<typename Iterator>
+  bool execute_pure_command( alice::command* cmd, Iterator begin, Iterator end, std::string_view line, std::chrono::system_clock::time_point const& now, nlohmann::json& log )
   {
-#if defined(ALICE_ENV_HOME)
-#define ALICE_STRINGIFY(x) #x
-#define ALICE_TOSTRING(x) ALICE_STRINGIFY(x)
-    std::string env = ALICE_TOSTRING( ALICE_ENV_HOME );
-    if ( env.empty() ) { return;}
+    auto key = cmd->pure_key( begin, end );
+    const auto* record = key.empty() ? nullptr : pure_cache.find( key );
+    const auto hit = record != nullptr;
 
-    if ( auto* path = std::getenv( env.c_str() ) )
+    detail::command_record fresh;
+    if ( hit )
     {
-      std::string alias_path = fmt::format( "{}/alias", path );
-      process_file( alias_path, false, false );
+      cmd->replay( begin, end, *record );
     }
-#endif
+    else
+    {
+      cmd->run_recorded( begin, end, fresh );
+      record = &fresh;
+    }
+
+    const auto result = record->result;
+    if ( result && ( env->log || env->_json ) )
+    {
+      log = record->log;
+      log["cache"] = {{"hit", hit}, {"hits", pure_cache.hits()}, {"misses", pure_cache.misses()}};
+    }
+    if ( result && env->log )
+    {
+      env->logger.log( log, std::string( line ), now );
+    }
+
+    if ( !hit && result && !key.empty() )
+    {
+      pure_cache.insert( std::move( key ), std::move( fresh ) );
+    }
+
+    return result;
   }
 
-  std::string preprocess_alias( const std::string& line )
+  alice::command* find_command( std::string_view name ) const
+  {
+    if ( auto* cmd = dispatch.find( name ) )
+    {
+      return cmd;
+    }
+
+    /* commands that were not known at compile time */
+    const auto it = env->_commands.find( std::string( name ) );
+    return it != env->_commands.end() ? it->second.get() : nullptr;
+  }
+
+  bool process_file( const std::string& filename, bool echo, bool error_on_not_found = true )
   {
-    std::smatch m;
+    const auto script = cached_script( filename );
 
-    for ( const auto& p : env->aliases() )
+    if ( !script )
     {
-      if ( std::regex_match( line, m, std::regex( p.first ) ) )
+      if ( error_on_not_found )
       {
-        std::vector<std::string> matches( m.size() - 1u );
+        env->print( "[e] file {} not found\n", filename );
+      }
+      return true;
+    }
 
-        for ( auto i = 0u; i < matches.size(); ++i )
-        {
-          matches[i] = std::string( m[i + 1] );
-        }
+    return execute_script( *script, echo );
+  }
 
-        const auto str = detail::trim_copy( detail::format_with_vector( p.second, matches ) );
-        return preprocess_alias( str );
-      }
+  /* executes a file that is included with `<file` in a script and that has
+     been created or changed after the script has been compiled */
+  bool execute_include( detail::script_operation const& op, bool echo )
+  {
+    const std::string filename( op.args.front() );
+    const auto script = cached_script( filename );
+
+    if ( !script )
+    {
+      env->err() << fmt::format( "[e] {}:{}: file {} not found", *op.location.filename, op.location.line, filename ) << std::endl;
+      return false;
     }
 
-    return line;
+    auto succeeded = false;
+    execute_script( *script, echo, &succeeded );
+    return succeeded;
   }
 
-public:
-  environment::ptr env;
+  /* executes lines from input that does not come from a terminal
 
-private:
-  std::string prefix;
-  std::shared_ptr<CLI::App> opts;
-  std::string category;
+     The input is read in large blocks, and neither prompts nor history are
+     written.  Lines are executed as they arrive, in the same way as in
+     interactive mode. */
+  void process_stream( std::FILE* stream, bool echo )
+  {
+    detail::line_reader reader( stream );
+    std::string line, next;
+
+    while ( !env->quit && reader.read_line( line ) )
+    {
+      detail::trim( line );
+
+      /* read lines until all blocks are closed */
+      while ( detail::open_blocks( line ) > 0 && reader.read_line( next ) )
+      {
+        detail::trim( next );
+        line += '\n' + next;
+      }
+
+      if ( echo && !line.empty() )
+      {
+        env->print( "{}{}\n", get_prefix(), line );
+      }
+      execute_line( detail::has_block( line ) ? line : preprocess_alias( line ) );
+    }
+  }
+
+  /* returns the compiled script for a file, or nullptr if the file cannot be
+     opened
+
+     Scripts are cached by the canonical path of the file, and compiled again,
+     if one of their files has changed (modification time or size), or if the
+     aliases have changed, since aliases are expanded at compile time. */
+  std::shared_ptr<const detail::script> cached_script( const std::string& filename )
+  {
+    const auto stamp = detail::file_stamp::of( filename );
+    if ( stamp.path.empty() )
+    {
+      return nullptr;
+    }
+
+    if ( const auto it = script_cache.find( stamp.path ); it != script_cache.end() )
+    {
+      if ( it->second.alias_generation == env->_alias_matcher.generation() && it->second.script->up_to_date() )
+      {
+        return it->second.script;
+      }
+      script_cache.erase( it );
+    }
+
+    auto script = std::make_shared<detail::script>();
+    if ( !compile_file( filename, *script ) )
+    {
+      return nullptr;
+    }
+
+    if ( script->errors.empty() )
+    {
+      script_cache[stamp.path] = {script, env->_alias_matcher.generation()};
+    }
+    return script;
+  }
+
+  /* compiles a file into a script, returns false if file cannot be opened
+
+     The contents of the file are copied into the script, such that the script
+     does not change if the file is changed while the script runs.  Included
+     files are compiled into the same script.  Lines without operations (e.g.,
+     comments) are echoed together with the next operation. */
+  bool compile_file( const std::string& filename, detail::script& script )
+  {
+    auto stamp = detail::file_stamp::of( filename );
+    std::ifstream in( filename.c_str(), std::ifstream::in | std::ifstream::binary );
+
+    if ( stamp.path.empty() || !in.good() )
+    {
+      return false;
+    }
+
+    /* the file is read with a single read into one buffer of the script; it
+       is not memory mapped, since the script is cached and may still run when
+       its file is truncated or rewritten */
+    std::string contents( stamp.size, '\0' );
+    in.read( contents.data(), contents.size() );
+    contents.resize( static_cast<std::size_t>( in.gcount() ) );
+
+    script.sources.push_back( stamp );
+    includes.push_back( stamp.path );
+    detail::script_location location{std::make_shared<const std::string>( filename ), 0u};
+    const auto blocks = script.blocks.size();
+    const char* pending = nullptr; /* first line that has not been echoed */
+    const char* end = nullptr;     /* end of the last line */
+
+    detail::for_each_line( script.store( std::move( contents ) ), [&]( std::string_view line ) {
+      line = detail::trim_view( line );
+      ++location.line;
+
+      if ( !pending )
+      {
+        pending = line.data();
+      }
+      end = line.data() + line.size();
+
+      const auto first = script.operations.size();
+      compile_statements( line, location, script );
+
+      if ( script.operations.size() > first )
+      {
+        script.operations[first].source = std::string_view( pending, end - pending );
+        pending = nullptr;
+      }
+    } );
+
+    close_open_blocks( blocks, script );
+
+    /* lines after the last operation are echoed by an operation that jumps to the end */
+    if ( pending )
+    {
+      auto& op = control_operation( detail::script_operation::kind::jump, {}, location, script );
+      op.jump = script.operations.size();
+      op.source = std::string_view( pending, end - pending );
+    }
+
+    includes.pop_back();
+    return true;
+  }
+
+  /* compiles a line that may open or close blocks
+
+     Lines without blocks are compiled by `compile_line`.  Otherwise, the line
+     is split into block headers, braces, and statements, such that blocks can
+     also be written in a single line, e.g., `for i in 1..3 { print $i }`. */
+  void compile_statements( std::string_view line, detail::script_location const& location, detail::script& script )
+  {
+    if ( !detail::has_block( line ) )
+    {
+      compile_line( line, location, script, false );
+      return;
+    }
+
+    auto chained = false;
+    while ( !( line = detail::trim_view( line ) ).empty() && line.front() != '#' )
+    {
+      if ( line.front() == ';' )
+      {
+        line.remove_prefix( 1u );
+        continue;
+      }
+
+      if ( detail::find_brace( line, '}' ) == 0u )
+      {
+        line = detail::trim_view( line.substr( 1u ) );
+        if ( line.substr( 0u, line.find_first_of( " \t" ) ) == "else" )
+        {
+          line = detail::trim_view( line.substr( 4u ) );
+          if ( detail::find_brace( line, '{' ) != 0u )
+          {
+            script.add_error( location, "missing { after else" );
+            return;
+          }
+          line.remove_prefix( 1u );
+          open_alternative( location, script );
+        }
+        else
+        {
+          close_block( location, script );
+        }
+        chained = false;
+        continue;
+      }
+
+      if ( const auto keyword = line.substr( 0u, line.find_first_of( " \t" ) ); keyword == "for" || keyword == "if" || keyword == "while" || keyword == "parallel" )
+      {
+        const auto brace = detail::find_brace( line, '{' );
+        if ( brace == std::string_view::npos )
+        {
+          script.add_error( location, fmt::format( "missing {{ after {}", keyword ) );
+          return;
+        }
+        open_block( keyword, line.substr( keyword.size(), brace - keyword.size() ), location, script );
+        line.remove_prefix( brace + 1u );
+        chained = false;
+        continue;
+      }
+
+      const auto end = detail::find_statement_end( line );
+      compile_line( detail::trim_view( line.substr( 0u, end ) ), location, script, chained );
+      chained = true;
+
+      if ( end == std::string_view::npos )
+      {
+        break;
+      }
+      line.remove_prefix( end );
+    }
+  }
+
+  /* opens a `for`, `if`, `while`, or `parallel` block, header is the text between keyword and brace */
+  void open_block( std::string_view keyword, std::string_view header, detail::script_location const& location, detail::script& script )
+  {
+    detail::line_tokenizer tokenizer;
+    if ( !tokenizer.tokenize( header ) )
+    {
+      script.add_error( location, "unterminated quote" );
+      return;
+    }
+
+    std::vector<std::string_view> args( tokenizer.tokens().begin(), tokenizer.tokens().end() );
+    auto type = detail::script_block::kind::loop;
+
+    if ( keyword == "for" )
+    {
+      if ( args.size() < 3u || !detail::interpolation::is_name( args[0] ) || args[1] != "in" )
+      {
+        script.add_error( location, "expected for <variable> in <items> {" );
+        return;
+      }
+      args.erase( args.begin() + 1 );
+    }
+    else if ( keyword == "parallel" )
+    {
+      if ( args.size() > 1u || ( args.size() == 1u && args[0].find_first_not_of( "0123456789" ) != std::string_view::npos ) )
+      {
+        script.add_error( location, "expected parallel [<jobs>] {" );
+        return;
+      }
+      if ( !script.blocks.empty() && script.blocks.back().type == detail::script_block::kind::parallel )
+      {
+        script.add_error( location, "parallel blocks cannot be nested" );
+        return;
+      }
+      type = detail::script_block::kind::parallel;
+    }
+    else if ( !detail::is_condition( args ) )
+    {
+      script.add_error( location, fmt::format( "invalid condition in {}", keyword ) );
+      return;
+    }
+    else
+    {
+      type = keyword == "if" ? detail::script_block::kind::branch : detail::script_block::kind::repetition;
+    }
+
+    const auto op_type = type == detail::script_block::kind::loop ? detail::script_operation::kind::loop : ( type == detail::script_block::kind::parallel ? detail::script_operation::kind::parallel : detail::script_operation::kind::branch );
+    script.blocks.push_back( {type, script.operations.size()} );
+    auto& op = control_operation( op_type, header, location, script );
+    op.args = std::move( args );
+    op.variables.compile( op.args.begin(), op.args.end() );
+  }
+
+  /* `} else {` switches from the then block of an `if` to its else block */
+  void open_alternative( detail::script_location const& location, detail::script& script )
+  {
+    if ( script.blocks.empty() || script.blocks.back().type != detail::script_block::kind::branch )
+    {
+      script.add_error( location, "else without if" );
+      return;
+    }
+
+    auto& block = script.blocks.back();
+    control_operation( detail::script_operation::kind::jump, "else", location, script );
+    script.operations[block.operation].jump = script.operations.size();
+    block = {detail::script_block::kind::alternative, script.operations.size() - 1u};
+  }
+
+  void close_block( detail::script_location const& location, detail::script& script )
+  {
+    if ( script.blocks.empty() )
+    {
+      script.add_error( location, "unexpected }" );
+      return;
+    }
+
+    const auto block = script.blocks.back();
+    script.blocks.pop_back();
+
+    switch ( block.type )
+    {
+    case detail::script_block::kind::loop:
+      control_operation( detail::script_operation::kind::next, "}", location, script ).jump = block.operation;
+      script.operations[block.operation].jump = script.operations.size() - 1u;
+      break;
+
+    case detail::script_block::kind::branch:
+    case detail::script_block::kind::alternative:
+      script.operations[block.operation].jump = script.operations.size();
+      break;
+
+    case detail::script_block::kind::repetition:
+      control_operation( detail::script_operation::kind::jump, "}", location, script ).jump = block.operation;
+      script.operations[block.operation].jump = script.operations.size();
+      break;
+
+    case detail::script_block::kind::parallel:
+      for ( auto i = block.operation + 1u; i < script.operations.size(); ++i )
+      {
+        if ( const auto type = script.operations[i].type; type != detail::script_operation::kind::command && type != detail::script_operation::kind::shell )
+        {
+          script.add_error( script.operations[i].location, "only commands can run in a parallel block" );
+          break;
+        }
+      }
+      script.operations[block.operation].jump = script.operations.size();
+      break;
+    }
+  }
+
+  /* reports blocks that have been opened after the first `first` ones and are not closed */
+  void close_open_blocks( std::size_t first, detail::script& script )
+  {
+    while ( script.blocks.size() > first )
+    {
+      script.add_error( script.operations[script.blocks.back().operation].location, "missing }" );
+      script.blocks.pop_back();
+    }
+  }
+
+  detail::script_operation& control_operation( detail::script_operation::kind type, std::string_view text, detail::script_location const& location, detail::script& script )
+  {
+    return script.operations.emplace_back( detail::script_operation{type, nullptr, {}, text, location, {}, false, {}} );
+  }
+
+  /* true, if one of the aliases that the script defines may apply to line,
+     such that it can only be expanded when the line is executed */
+  bool expands_on_execution( std::string_view line, detail::script const& script ) const
+  {
+    std::string expansion;
+    return script.unknown_aliases || script.aliases.expand( line, expansion );
+  }
+
+  /* returns line itself if no alias applies, otherwise the expansion owned by script */
+  std::string_view expand_alias( std::string_view line, detail::script& script )
+  {
+    if ( env->aliases().empty() )
+    {
+      return line;
+    }
+
+    auto expanded = preprocess_alias( std::string( line ) );
+    return expanded == line ? line : script.store( std::move( expanded ) );
+  }
+
+  /* records the alias that an `alias` command defines, when the pattern
+     cannot be determined, any line may be an alias */
+  template<typename Iterator>
+  void declare_alias( Iterator begin, Iterator end, detail::script& script )
+  {
+    if ( end - begin != 3 || detail::has_variables( *( begin + 1 ) ) || detail::has_variables( *( begin + 2 ) ) ||
+         ( *( begin + 1 ) ).front() == '-' || ( *( begin + 2 ) ).front() == '-' )
+    {
+      script.unknown_aliases = true;
+      return;
+    }
+
+    std::string pattern_buffer, expansion_buffer;
+    try
+    {
+      script.aliases.insert( std::string( detail::unquote_argument( *( begin + 1 ), pattern_buffer ) ),
+                             std::string( detail::unquote_argument( *( begin + 2 ), expansion_buffer ) ) );
+    }
+    catch ( const std::regex_error& )
+    {
+      /* reported when the alias is defined */
+    }
+  }
+
+  /* compiles a line in the same way as `execute_line` would execute it */
+  void compile_line( std::string_view line, detail::script_location const& location, detail::script& script, bool chained )
+  {
+    if ( line.empty() || line[0] == '#' )
+    {
+      return;
+    }
+
+    if ( tokenizers.size() <= depth )
+    {
+      tokenizers.push_back( std::make_unique<detail::line_tokenizer>() );
+    }
+
+    /* aliases that the script defines are expanded on execution, all others now */
+    const auto expand = expands_on_execution( line, script );
+    if ( !expand )
+    {
+      line = expand_alias( line, script );
+    }
+
+    ++depth;
+    const auto first = script.operations.size();
+    compile_tokenized_line( line, location, script, chained, expand, *tokenizers[depth - 1u] );
+    --depth;
+
+    for ( auto i = first; expand && i < script.operations.size(); ++i )
+    {
+      script.operations[i].expand = true;
+    }
+  }
+
+  void compile_tokenized_line( std::string_view line, detail::script_location const& location, detail::script& script, bool chained, bool expand, detail::line_tokenizer& tokenizer )
+  {
+    if ( !tokenizer.tokenize( line ) )
+    {
+      script.add_error( location, "unterminated quote" );
+      return;
+    }
+
+    const auto& commands = tokenizer.commands();
+
+    if ( commands.size() > 1u )
+    {
+      for ( const auto& part : commands )
+      {
+        compile_line( part.text, location, script, chained );
+        chained = true;
+      }
+      return;
+    }
+
+    const auto& part = commands.front();
+
+    if ( part.text.front() == '!' )
+    {
+      script.operations.push_back( {detail::script_operation::kind::shell, nullptr, {part.text.substr( 1u )}, line, location, {}, chained, {}} );
+      if ( detail::has_variables( part.text ) )
+      {
+        script.operations.back().variables.compile( script.operations.back().args.begin(), script.operations.back().args.end(), true );
+      }
+      return;
+    }
+
+    /* included files are compiled into the script, files that do not exist
+       yet are compiled on execution, since earlier operations may create them */
+    if ( part.text.front() == '<' )
+    {
+      const auto index = script.operations.size();
+      script.operations.push_back( {detail::script_operation::kind::include, nullptr, {detail::trim_view( part.text.substr( 1u ) )}, line, location, {}, chained, {}} );
+
+      const std::string filename( script.operations.back().args.front() );
+      if ( const auto path = detail::file_stamp::of( filename ).path; std::find( includes.begin(), includes.end(), path ) != includes.end() )
+      {
+        script.add_error( location, fmt::format( "recursive include of file {}", filename ) );
+      }
+      else if ( compile_file( filename, script ) )
+      {
+        script.operations[index].jump = script.operations.size();
+      }
+      return;
+    }
+
+    if ( detail::is_job( tokenizer.begin( part ), tokenizer.end( part ) ) )
+    {
+      const auto name = tokenizer.begin( part ) + 1 == tokenizer.end( part ) ? std::string_view() : tokenizer.tokens()[part.first];
+      if ( !find_command( name ) && !detail::has_variables( name ) && !expand )
+      {
+        script.add_error( location, name.empty() ? std::string( "missing command before &" ) : fmt::format( "unknown command: {}", name ) );
+      }
+
+      script.operations.push_back( {detail::script_operation::kind::job, nullptr, {tokenizer.begin( part ), tokenizer.end( part ) - 1}, line, location, {}, chained, {}} );
+      script.operations.back().variables.compile( tokenizer.begin( part ), tokenizer.end( part ) - 1 );
+      return;
+    }
+
+    if ( detail::has_pipe( part.text, tokenizer.begin( part ), tokenizer.end( part ) ) )
+    {
+      /* the commands of a line that an alias may expand are looked up on execution */
+      const auto last = expand ? tokenizer.begin( part ) : tokenizer.end( part );
+      for ( auto it = tokenizer.begin( part ); it != last; ++it )
+      {
+        if ( ( it == tokenizer.begin( part ) || *( it - 1 ) == "|" ) && *it != "|" && !find_command( *it ) && !detail::has_variables( *it ) )
+        {
+          script.add_error( location, fmt::format( "unknown command: {}", *it ) );
+        }
+      }
+
+      script.operations.push_back( {detail::script_operation::kind::pipe, nullptr, {tokenizer.begin( part ), tokenizer.end( part )}, line, location, {}, chained, {}} );
+      script.operations.back().variables.compile( tokenizer.begin( part ), tokenizer.end( part ) );
+      return;
+    }
+
+    const auto name = tokenizer.tokens()[part.first];
+    auto* cmd = find_command( name );
+
+    /* commands whose name refers to a variable or that may be an alias of the script are looked up on execution */
+    if ( !cmd && !detail::has_variables( name ) && !expand )
+    {
+      script.add_error( location, fmt::format( "unknown command: {}", name ) );
+      return;
+    }
+
+    /* aliases are defined when the command is executed */
+    if ( dynamic_cast<alias_command*>( cmd ) )
+    {
+      declare_alias( tokenizer.begin( part ), tokenizer.end( part ), script );
+    }
+
+    script.operations.push_back( {detail::script_operation::kind::command, cmd, {tokenizer.begin( part ), tokenizer.end( part )}, line, location, {}, chained, {}} );
+    if ( detail::has_variables( part.text ) )
+    {
+      script.operations.back().variables.compile( tokenizer.begin( part ), tokenizer.end( part ) );
+    }
+  }
+
+  /* executes a compiled script, returns true if the shell should quit
+
+     If succeeded is given, it is set to false if the script contains errors
+     or if one of its operations failed. */
+  bool execute_script( detail::script const& script, bool echo, bool* succeeded = nullptr )
+  {
+    if ( succeeded )
+    {
+      *succeeded = script.errors.empty();
+    }
+
+    if ( !script.errors.empty() )
+    {
+      for ( const auto& error : script.errors )
+      {
+        env->err() << "[e] " << error << std::endl;
+      }
+      return false;
+    }
+
+    auto result = true;
+    std::vector<std::string> values;
+    std::vector<std::string_view> args;
+    std::vector<detail::loop_items> loops; /* items of active loops */
+
+    for ( std::size_t pc = 0u; pc < script.operations.size(); ++pc )
+    {
+      const auto& op = script.operations[pc];
+
+      if ( echo )
+      {
+        echo_source( op.source );
+      }
+
+      /* commands after a failed command in the same line are skipped */
+      if ( op.chained && !result )
+      {
+        continue;
+      }
+
+      /* aliases that the script defines are expanded on execution */
+      if ( const auto expansion = expand_operation( op ) )
+      {
+        result = execute_line( *expansion );
+        if ( succeeded && !result )
+        {
+          *succeeded = false;
+        }
+        if ( env->quit )
+        {
+          return true;
+        }
+        continue;
+      }
+
+      switch ( op.type )
+      {
+      case detail::script_operation::kind::shell:
+        if ( !op.variables.empty() )
+        {
+          op.variables.evaluate( op.args.begin(), op.args.end(), env->_variables, values, args );
+        }
+        result = execute_shell( std::string( op.variables.empty() ? op.args.front() : args.front() ), op.text );
+        break;
+
+      case detail::script_operation::kind::command:
+        if ( !op.variables.empty() )
+        {
+          result = execute_interpolated( op.variables, op.cmd, op.args.begin(), op.args.end(), op.text );
+        }
+        else if ( auto* cmd = op.cmd ? op.cmd : find_command( op.args.front() ) )
+        {
+          result = execute_command( cmd, op.args.begin(), op.args.end(), op.text );
+        }
+        else
+        {
+          env->err() << "[e] unknown command: " << op.args.front() << std::endl;
+          result = false;
+        }
+        break;
+
+      case detail::script_operation::kind::pipe:
+        if ( op.variables.empty() )
+        {
+          result = execute_pipeline( op.args.begin(), op.args.end(), op.args.begin(), op.text );
+        }
+        else
+        {
+          op.variables.evaluate( op.args.begin(), op.args.end(), env->_variables, values, args );
+          result = execute_pipeline( args.begin(), args.end(), op.args.begin(), op.text );
+        }
+        break;
+
+      case detail::script_operation::kind::job:
+        result = start_job( op.args.begin(), op.args.end(), op.text, op.variables );
+        break;
+
+      case detail::script_operation::kind::include:
+        /* the operations of the file follow, unless it has been created or changed since compilation */
+        if ( op.jump == 0u || !script.compiled_from( std::string( op.args.front() ) ) )
+        {
+          result = execute_include( op, echo );
+          if ( op.jump != 0u )
+          {
+            pc = op.jump - 1u;
+          }
+        }
+        break;
+
+      case detail::script_operation::kind::loop:
+        op.variables.evaluate( op.args.begin(), op.args.end(), env->_variables, values, args );
+        if ( !loops.emplace_back().start( {args.begin() + 1, args.end()} ) )
+        {
+          loops.pop_back();
+          pc = op.jump;
+        }
+        else
+        {
+          env->_variables[std::string( op.args.front() )] = loops.back().value();
+        }
+        break;
+
+      case detail::script_operation::kind::next:
+        if ( loops.back().next() )
+        {
+          env->_variables[std::string( script.operations[op.jump].args.front() )] = loops.back().value();
+          pc = op.jump;
+        }
+        else
+        {
+          loops.pop_back();
+        }
+        break;
+
+      case detail::script_operation::kind::branch:
+        op.variables.evaluate( op.args.begin(), op.args.end(), env->_variables, values, args );
+        if ( !detail::evaluate_condition( args ) )
+        {
+          pc = op.jump - 1u;
+        }
+        break;
+
+      case detail::script_operation::kind::jump:
+        pc = op.jump - 1u;
+        break;
+
+      case detail::script_operation::kind::parallel:
+        result = execute_parallel( script, pc + 1u, op.jump, op.args.empty() ? 0u : static_cast<unsigned>( std::stoul( std::string( op.args.front() ) ) ), echo );
+        pc = op.jump - 1u;
+        break;
+      }
+
+      if ( succeeded && !result )
+      {
+        *succeeded = false;
+      }
+
+      if ( env->quit )
+      {
+        /* quit */
+        return true;
+      }
+    }
+
+    /* do not quit */
+    return false;
+  }
+
+  /* the expansion of an operation that has been compiled for expansion on
+     execution, if an alias applies to it by then */
+  std::optional<std::string> expand_operation( detail::script_operation const& op )
+  {
+    if ( !op.expand || env->_alias_matcher.empty() )
+    {
+      return std::nullopt;
+    }
+
+    auto expansion = preprocess_alias( std::string( op.text ) );
+    if ( expansion == op.text )
+    {
+      return std::nullopt;
+    }
+    return expansion;
+  }
+
+  /* echoes the source lines of an operation, empty lines included */
+  void echo_source( std::string_view source )
+  {
+    if ( !source.data() )
+    {
+      return;
+    }
+
+    for ( std::size_t pos = 0u;; )
+    {
+      const auto nl = source.find( '\n', pos );
+      env->print( "{}{}\n", get_prefix(), detail::trim_view( source.substr( pos, nl == std::string_view::npos ? nl : nl - pos ) ) );
+      if ( nl == std::string_view::npos )
+      {
+        break;
+      }
+      pos = nl + 1u;
+    }
+  }
+
+  /* runs the operations [first, last) of a parallel block on up to jobs
+     threads (0 uses all cores) and waits for all of them
+
+     Variables are substituted before any operation starts, and each command
+     runs on its own instance.  The output of each operation is buffered and
+     written in the order of the operations.  If some command has no factory,
+     the block runs sequentially.  Returns false and reports the location of
+     the first operation that failed, if any. */
+  bool execute_parallel( detail::script const& script, std::size_t first, std::size_t last, unsigned jobs, bool echo )
+  {
+    const auto num_tasks = last - first;
+    const auto now = std::chrono::system_clock::now();
+
+    std::vector<std::vector<std::string>> args( num_tasks );
+    std::vector<std::optional<std::string>> expansions( num_tasks );
+    std::vector<std::shared_ptr<alice::command>> instances( num_tasks );
+    std::vector<std::string> values;
+    std::vector<std::string_view> views;
+    auto parallel = true;
+
+    for ( auto task = 0u; task < num_tasks; ++task )
+    {
+      const auto& op = script.operations[first + task];
+
+      /* expanded aliases are executed as command lines */
+      if ( ( expansions[task] = expand_operation( op ) ) )
+      {
+        if ( parallel )
+        {
+          env->err() << "[w] alias " << op.text << " cannot run in parallel, block runs sequentially" << std::endl;
+        }
+        parallel = false;
+        continue;
+      }
+
+      if ( op.variables.empty() )
+      {
+        args[task].assign( op.args.begin(), op.args.end() );
+      }
+      else
+      {
+        op.variables.evaluate( op.args.begin(), op.args.end(), env->_variables, values, views );
+        args[task].assign( views.begin(), views.end() );
+      }
+
+      if ( op.type == detail::script_operation::kind::command && !( instances[task] = env->create_command( args[task].front() ) ) )
+      {
+        if ( parallel )
+        {
+          env->err() << "[w] command " << args[task].front() << " cannot run in parallel, block runs sequentially" << std::endl;
+        }
+        parallel = false;
+      }
+    }
+
+    std::vector<std::ostringstream> outputs( num_tasks ), errors( num_tasks );
+    std::vector<char> results( num_tasks );
+    std::vector<nlohmann::json> logs( num_tasks );
+
+    const auto run = [&]( std::size_t task ) {
+      const auto& op = script.operations[first + task];
+      if ( expansions[task] )
+      {
+        results[task] = execute_line( *expansions[task] );
+        return;
+      }
+
+      if ( op.type == detail::script_operation::kind::shell )
+      {
+        const auto result = detail::execute_program( args[task].front() );
+        outputs[task] << result.second;
+        logs[task] = {{"status", result.first}, {"output", result.second}};
+        results[task] = true;
+        return;
+      }
+
+      auto* cmd = instances[task].get();
+      if ( !cmd && !( cmd = find_command( args[task].front() ) ) )
+      {
+        errors[task] << "[e] unknown command: " << args[task].front() << std::endl;
+        return;
+      }
+
+      if ( ( results[task] = cmd->run_tokens( args[task].begin(), args[task].end() ) ) && ( env->log || env->_json ) )
+      {
+        logs[task] = cmd->log();
+      }
+    };
+
+    if ( parallel )
+    {
+      detail::parallel_for( num_tasks, detail::num_workers( jobs, num_tasks ), [&]( std::size_t task, unsigned ) {
+        detail::thread_context context;
+        context.worker = true;
+        context.out = &outputs[task];
+        context.err = &errors[task];
+        detail::thread_context_guard guard( context );
+        run( task );
+      } );
+    }
+    else
+    {
+      for ( auto task = 0u; task < num_tasks; ++task )
+      {
+        detail::thread_context context = detail::this_thread_context();
+        context.out = &outputs[task];
+        context.err = &errors[task];
+        detail::thread_context_guard guard( context );
+        run( task );
+      }
+    }
+
+    /* merge in the order of the operations */
+    auto failed = num_tasks;
+    for ( auto task = 0u; task < num_tasks; ++task )
+    {
+      const auto& op = script.operations[first + task];
+      if ( echo )
+      {
+        echo_source( op.source );
+      }
+
+      if ( env->_json )
+      {
+        write_json_line( logs[task], op.text, results[task], outputs[task].str(), errors[task].str() );
+      }
+      else
+      {
+        env->out() << outputs[task].str();
+        env->err() << errors[task].str();
+      }
+
+      if ( results[task] && env->log )
+      {
+        env->logger.log( logs[task], std::string( op.text ), now );
+      }
+      if ( !results[task] && failed == num_tasks )
+      {
+        failed = task;
+      }
+    }
+    env->command_finished();
+
+    if ( failed != num_tasks )
+    {
+      const auto& location = script.operations[first + failed].location;
+      env->err() << fmt::format( "[e] {}:{}: command in parallel block failed: {}", *location.filename, location.line, script.operations[first + failed].text ) << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  std::string get_prefix()
+  {
+    std::string r = prefix;
+
+    if ( env->has_default_option() )
+    {
+      r += fmt::format( " [{}]", env->default_option() );
+    }
+    if ( opts->count( "-n" ) )
+    {
+      r += fmt::format( " {}", counter++ );
+    }
+    return r + "> ";
+  }
+
+  void read_aliases()
+  {
+#if defined(ALICE_ENV_HOME)
+#define ALICE_STRINGIFY(x) #x
+#define ALICE_TOSTRING(x) ALICE_STRINGIFY(x)
+    std::string env = ALICE_TOSTRING( ALICE_ENV_HOME );
+    if ( env.empty() ) { return;}
+
+    if ( auto* path = std::getenv( env.c_str() ) )
+    {
+      std::string alias_path = fmt::format( "{}/alias", path );
+      process_file( alias_path, false, false );
+    }
+#endif
+  }
+
+  std::string preprocess_alias( const std::string& line )
+  {
+    /* expansions of recursive aliases are stopped after a fixed number of steps */
+    constexpr auto max_alias_depth = 32u;
+
+    auto& matcher = env->_alias_matcher;
+    if ( matcher.empty() )
+    {
+      return line;
+    }
+
+    if ( const auto* cached = matcher.cache().find( line ) )
+    {
+      return *cached;
+    }
+
+    auto result = line;
+    std::string expanded;
+
+    for ( auto i = 0u; i < max_alias_depth; ++i )
+    {
+      if ( !matcher.expand( result, expanded ) )
+      {
+        matcher.cache().insert( line, result );
+        return result;
+      }
+      result.swap( expanded );
+    }
+
+    env->err() << "[e] alias expansion of " << line << " exceeds " << max_alias_depth << " steps" << std::endl;
+    return {};
+  }
+
+public:
+  environment::ptr env;
+
+private:
+  std::string prefix;
+  std::shared_ptr<CLI::App> opts;
+  std::string category;
+  detail::command_table dispatch;
+  std::vector<std::unique_ptr<detail::line_tokenizer>> tokenizers;
+  unsigned depth{0u};
+  detail::lru_cache<detail::command_record> pure_cache{64u}; /* executions of pure commands */
+
+  struct cached_script_entry
+  {
+    std::shared_ptr<const detail::script> script;
+    uint64_t alias_generation;
+  };
+  std::unordered_map<std::string, cached_script_entry> script_cache; /* compiled script files by canonical path */
+  std::vector<std::string> includes;                                 /* files that are currently being compiled */
 
   std::string command, file, logname;
 
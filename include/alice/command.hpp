@@ -32,11 +32,19 @@
 
 #pragma once
 
+#include <algorithm>
 #include <any>
+#include <array>
+#include <cstdint>
+#include <deque>
 #include <fstream>
 #include <functional>
+#include <iterator>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
@@ -44,7 +52,14 @@
 #include <fmt/format.h>
 #include <nlohmann/json.hpp>
 
+#include "detail/alias_matcher.hpp"
+#include "detail/command_cache.hpp"
+#include "detail/jobs.hpp"
 #include "detail/logging.hpp"
+#include "detail/mapped_file.hpp"
+#include "detail/option_schema.hpp"
+#include "detail/output_sink.hpp"
+#include "detail/parallel.hpp"
 #include "detail/utils.hpp"
 #include "settings.hpp"
 #include "store.hpp"
@@ -69,6 +84,11 @@ public:
   /*! \brief Smart pointer alias for environment */
   using ptr = std::shared_ptr<environment>;
 
+  environment()
+  {
+    _err_sink.tie( &_out_sink );
+  }
+
   /*! \brief Retrieves store from environment
 
     The store can be accessed using its type.
@@ -98,9 +118,17 @@ public:
     This method returns a reference to the current standard output stream.  In
     stand-alone application mode, this is ``std::cout`` by default, but can be
     changed.  Users should aim for not printing to ``std::cout`` directly in a
-    command, but use ``env->out()`` instead.
+    command, but use ``env->out()`` instead.  Commands that run on a worker
+    thread (e.g., in ``foreach --jobs``) write into a private buffer instead.
+
+    The output is buffered by the environment and written according to the
+    flush policy (see ``set_flush_policy``).
   */
-  inline std::ostream& out() const { return *_out; }
+  inline std::ostream& out() const
+  {
+    auto* out = detail::this_thread_context().out;
+    return out ? *out : _out_stream;
+  }
 
   /*! \brief Retreives standard error stream
 
@@ -108,18 +136,119 @@ public:
     stand-alone application mode, this is ``std::cerr`` by default, but can be
     changed.  Users should aim for not printing to ``std::cerr`` directly in a
     command, but use ``env->err()`` instead.
+
+    Error messages are not buffered, but buffered output is written before
+    them.
   */
-  inline std::ostream& err() const { return *_err; }
+  inline std::ostream& err() const
+  {
+    auto* err = detail::this_thread_context().err;
+    return err ? *err : _err_stream;
+  }
+
+  /*! \brief Prints formatted output
+
+    Formats the arguments into a memory buffer on the stack, using the format
+    syntax of the fmt library, and writes the result into ``out()`` in one
+    piece.  Unlike streaming the result of ``fmt::format`` into ``out()``, no
+    temporary string is created.
+
+    .. code-block:: c++
+
+       env->print( "[i] {} has {} nodes\n", name, num_nodes );
+
+    \param format Format string
+    \param args Arguments to format
+  */
+  template<typename... Args>
+  void print( fmt::string_view format, const Args&... args ) const
+  {
+    fmt::memory_buffer buffer;
+    fmt::format_to( buffer, format, args... );
+    out().write( buffer.data(), static_cast<std::streamsize>( buffer.size() ) );
+  }
 
   /*! \brief Changes output and error streams
 
     This method allows to change the output streams which are returned by
-    ``out()`` and ``err()``.
+    ``out()`` and ``err()``.  Buffered output is written to the previous
+    output stream.
   */
   inline void reroute( std::ostream& new_out, std::ostream& new_err )
   {
-    _out = &new_out;
-    _err = &new_err;
+    _out_sink.set_target( &new_out );
+    _err_sink.set_target( &new_err );
+  }
+
+  /*! \brief Sets when buffered output is written to the output stream
+
+    By default, output is written after each line, if the output stream is a
+    terminal, and after each command otherwise.  With
+    ``flush_policy::size``, output is only written when the buffer is full
+    and before the shell waits for input, which is fastest for commands that
+    print a lot.  Explicit flushes, e.g., with ``std::endl``, only take
+    effect with ``flush_policy::line``.
+
+    \param policy Flush policy
+  */
+  inline void set_flush_policy( flush_policy policy )
+  {
+    _out_sink.set_policy( policy );
+  }
+
+  /*! \brief Writes buffered output to the output stream */
+  inline void flush()
+  {
+    _out_sink.flush();
+    _err_sink.flush();
+  }
+
+  /*! \brief Retrieves the stream into which the next command in a pipe reads
+
+    If a command is followed by ``|`` in a command line, such as in
+    ``write_aiger | read_aiger``, this method returns the stream that is
+    passed to the next command, otherwise ``nullptr``.  Write commands write
+    the current store element into this stream instead of into a file.
+    Commands should set ``badbit`` on the stream, if they cannot write into it,
+    then the next command is not executed.
+  */
+  inline std::ostream* pipe_output() const
+  {
+    return _pipe_out;
+  }
+
+  /*! \brief Retrieves the stream that the previous command in a pipe has written
+
+    Returns ``nullptr``, if the command is not preceded by ``|``.  Read
+    commands that are called without filename read from this stream.
+  */
+  inline std::istream* pipe_input() const
+  {
+    return _pipe_in;
+  }
+
+  /*! \brief Checks whether the running command has been cancelled
+
+    Commands that run in the background (started with a trailing ``&``) can
+    be cancelled with ``kill``.  Since threads cannot be stopped from the
+    outside, long-running commands should check this method regularly and
+    return early.  Always returns ``false`` for other commands.
+  */
+  inline bool cancelled() const
+  {
+    const auto* flag = detail::this_thread_context().cancelled;
+    return flag && *flag;
+  }
+
+  /*! \brief Checks whether the shell writes JSON lines
+
+    If the shell is started with ``--json``, the log of each command is
+    written together with its output as one JSON object per line.  Commands
+    can skip text output, if its information is contained in their log.
+  */
+  inline bool json_output() const
+  {
+    return _json;
   }
 
   /*! \brief Returns map of commands
@@ -131,6 +260,20 @@ public:
     return _commands;
   }
 
+  /*! \brief Creates a new instance of a command
+
+    Returns ``nullptr``, if the command does not exist or has been added
+    without a factory.  Separate instances are used to run a command on
+    several threads at the same time.
+
+    \param name Command name
+  */
+  std::shared_ptr<command> create_command( const std::string& name ) const
+  {
+    const auto it = _command_factories.find( name );
+    return it != _command_factories.end() ? it->second() : nullptr;
+  }
+
   /*! \brief Returns map of categories
   
     Keys are catgory names pointing to a vector of command names that can be
@@ -178,11 +321,17 @@ public:
     ``ALICE_SETTINGS_WITH_DEFAULT_OPTION`` to ``true``, before the
     ``alice.hpp`` is included.
 
+    The default store option is not changed by commands that run on a worker
+    thread.
+
     \param default_option Updates default store option for next commands
   */
   void set_default_option( const std::string& default_option )
   {
-    _default_option = default_option;
+    if ( !detail::this_thread_context().worker )
+    {
+      _default_option = default_option;
+    }
   }
 
   /*! \brief Returns the current default store option */
@@ -216,6 +365,15 @@ public:
   }
 
 private:
+  /* writes buffered output according to the flush policy, output of worker threads is written by the caller */
+  void command_finished()
+  {
+    if ( !detail::this_thread_context().out )
+    {
+      _out_sink.command_finished();
+    }
+  }
+
   /*! \brief Adds store to environment */
   template<typename T>
   void add_store()
@@ -243,20 +401,83 @@ private:
   /* quit command is friend to update quit flag */
   friend class quit_command;
 
+  /* command is friend to write buffered output */
+  friend class command;
+
+  /* job commands are friends to access background jobs */
+  friend class jobs_command;
+  friend class wait_command;
+  friend class kill_command;
+
 private:
   std::unordered_map<std::string, std::shared_ptr<void>> _stores;
   std::unordered_map<std::string, std::shared_ptr<command>> _commands;
+  std::unordered_map<std::string, std::function<std::shared_ptr<command>()>> _command_factories;
   std::unordered_map<std::string, std::vector<std::string>> _categories;
   std::unordered_map<std::string, std::string> _aliases;
+  alice::detail::alias_matcher _alias_matcher;
   std::unordered_map<std::string, std::string> _variables;
   std::string _default_option;
+  std::istream* _pipe_in{nullptr};
+  std::ostream* _pipe_out{nullptr};
 
   bool log{false};
   alice::detail::logger logger;
+  bool _json{false};
   bool quit{false};
 
-  std::ostream* _out = &std::cout;
-  std::ostream* _err = &std::cerr;
+  detail::output_sink _out_sink{&std::cout};
+  detail::output_sink _err_sink{&std::cerr, flush_policy::line};
+  mutable std::ostream _out_stream{&_out_sink};
+  mutable std::ostream _err_stream{&_err_sink};
+
+  /* destroyed first, such that jobs can still access the environment */
+  detail::job_list _jobs;
+};
+
+/*! \brief Typed handle to an anonymous option
+
+  A handle is returned by ``command::add_option`` for anonymous options and by
+  ``command::find_option``.  It gives direct access to the option value and to
+  the CLI11 option, e.g., to call ``->required()`` on it.  Reading the value
+  does not require any lookup.
+*/
+template<typename T>
+class option_handle
+{
+public:
+  option_handle() = default;
+
+  option_handle( CLI::Option* option, const T* value )
+      : _option( option ),
+        _value( value )
+  {
+  }
+
+  /*! \brief Checks whether the handle points to an option */
+  inline explicit operator bool() const { return _value != nullptr; }
+
+  /*! \brief Returns the option value */
+  inline const T& value() const { return *_value; }
+
+  /*! \brief Returns the option value */
+  inline const T& operator*() const { return *_value; }
+
+  /*! \brief Returns the option value, or default value if option was not set */
+  inline T value_or( const T& default_value ) const { return is_set() ? *_value : default_value; }
+
+  /*! \brief Checks whether the option was set when calling the command */
+  inline bool is_set() const { return _option && _option->count() > 0u; }
+
+  /*! \brief Access to CLI11 option */
+  inline CLI::Option* operator->() const { return _option; }
+
+  /*! \brief Access to CLI11 option */
+  inline operator CLI::Option*() const { return _option; }
+
+private:
+  CLI::Option* _option{nullptr};
+  const T* _value{nullptr};
 };
 
 /*! \brief Command base class */
@@ -276,6 +497,21 @@ public:
   */
   using rules = std::vector<rule>;
 
+  /*! \brief Rule with lazily created error message
+
+    Like ``rule``, but the error message is created by a function, which is
+    only called when the validator fails.  Rules of this type are added once
+    with ``add_rule``.  They can also be used in place of ``rule``, e.g., in
+    the vector returned by ``validity_rules``.
+  */
+  struct lazy_rule
+  {
+    std::function<bool()> validator;
+    std::function<std::string()> message;
+
+    operator rule() const { return {validator, message()}; }
+  };
+
   /*! \brief Default constructor
 
     The shell environment that is passed as the first argument should be the one
@@ -329,6 +565,55 @@ protected:
   */
   virtual rules validity_rules() const { return {}; }
 
+public:
+  /*! \brief Adds a rule to check validity of command line arguments
+
+    Unlike ``validity_rules``, which is called for each execution, rules are
+    added once, typically in the constructor.  Before each execution, the
+    validators are evaluated in the order in which they were added (and before
+    the rules from ``validity_rules``), which does not allocate memory.  The
+    error message of the first failing rule is printed and the command is not
+    executed.
+
+    \verbatim embed:rst
+        .. code-block:: c++
+
+           example_command( const environment::ptr& env )
+               : command( env, "Example command" )
+           {
+             add_flag( "-a", "flag a" );
+             add_flag( "-b", "flag b" );
+
+             add_rule( has_store_element<std::string>( env ) );
+             add_rule( [this]() { return !( is_set( "a" ) && is_set( "b" ) ); }, "not both -a and -b can be set" );
+           }
+    \endverbatim
+
+    \param validator Nullary predicate that returns ``true`` in the correct case
+    \param message Error message
+  */
+  inline void add_rule( std::function<bool()> validator, const char* message )
+  {
+    registered_rules.push_back( {std::move( validator ), [message]() { return std::string( message ); }} );
+  }
+
+  /*! \brief Adds a rule with lazily created error message
+
+    \param validator Nullary predicate that returns ``true`` in the correct case
+    \param message Function that returns the error message
+  */
+  inline void add_rule( std::function<bool()> validator, std::function<std::string()> message )
+  {
+    registered_rules.push_back( {std::move( validator ), std::move( message )} );
+  }
+
+  /*! \brief Adds a rule, e.g., one of the predefined rules */
+  inline void add_rule( lazy_rule rule )
+  {
+    registered_rules.push_back( std::move( rule ) );
+  }
+
+protected:
   /*! \brief Executes the command
   
     This function must be implemented and contains the main routine that the
@@ -435,29 +720,63 @@ public:
     the store API, e.g., ``can_read`` together with ``read``, where command line
     options are setup in one function but used in another.
 
-    Use a type as template argument to specify the type of the option value and
-    use ``option_value`` to return the option value using any of the option
-    names (incl. possible dashes).
+    Use a type as template argument to specify the type of the option value.
+    The returned handle gives access to the option value, and can be used as
+    the option instance, e.g., ``cmd.add_option<int>( "--num", "number"
+    )->required()``.  Alternatively, use ``find_option`` or ``option_value`` to
+    access the option using any of the option names (incl. possible dashes).
 
     \param name Option names (short options are prefixed with a single dash,
                 long options with a double dash, positional options without any
                 dash), multiple option names are separated by a comma.
     \param description Description for the help text
-    \return Option instance
+    \return Option handle
   */
   template<typename T = std::string>
-  inline auto add_option( const std::string& name, const std::string& description )
+  inline option_handle<T> add_option( const std::string& name, const std::string& description )
   {
-    const auto index = options.size();
-    options.push_back( T() );
-    auto opt = opts.add_option( name, std::any_cast<T&>( options.back() ), description );
+    const auto index = static_cast<unsigned>( options.size() );
+    auto& entry = options.emplace_back( anonymous_option{nullptr, T()} );
+    auto& value = std::any_cast<T&>( entry.value );
+    auto opt = opts.add_option( name, value, description );
+    entry.option = opt;
 
-    for ( const auto& name : detail::split( opt->get_name(), "," ) )
+    for ( auto name : detail::split( opt->get_name(), "," ) )
     {
+      detail::trim( name );
       option_index[name] = index;
     }
 
-    return opt;
+    return {opt, &value};
+  }
+
+  /*! \brief Returns a handle to an anonymous option
+
+    Use any of the option names to find the option.  The handle is invalid, if
+    the name does not point to an anonymous option of type ``T``.  Finding the
+    option requires a lookup, therefore code that reads an option repeatedly
+    should keep the handle.
+
+    \param name One of the option names that was used to create the option
+    \return Option handle
+  */
+  template<typename T = std::string>
+  inline option_handle<T> find_option( const std::string& name ) const
+  {
+    const auto it = option_index.find( name );
+    if ( it == option_index.end() )
+    {
+      return {};
+    }
+
+    const auto& entry = options[it->second];
+    const auto* value = std::any_cast<T>( &entry.value );
+    if ( !value )
+    {
+      return {};
+    }
+
+    return {entry.option, value};
   }
 
   /*! \brief Returns the value for an anonymous option
@@ -483,43 +802,29 @@ public:
     }
     else
     {
-      const std::any& a = options.at( it->second );
+      const std::any& a = options[it->second].value;
       return *std::any_cast<T>( &a );
     }
   }
 
   /*! \brief Checks whether an option was set when calling the command
 
-    Any of the option names can be passed, with our without dashes.
+    Any of the option names can be passed, with our without dashes.  Names
+    without dashes refer to a short option, if they consist of a single
+    character and such a short option exists, and to a long option
+    otherwise.
 
     \param name Option name
   */
-  inline bool is_set( const std::string& name ) const
+  inline bool is_set( std::string_view name ) const
   {
-    try
-    {
-      if ( name.empty() )
-      {
-        return false;
-      }
-      else if ( name.front() == '-' )
-      {
-        return opts.count( name );
-      }
-      else if ( name.size() == '1' )
-      {
-        return opts.count( "-" + name );
-      }
-      else
-      {
-        return opts.count( "--" + name );
-      }
-    }
-    catch ( const CLI::OptionNotFound& e )
+    if ( !schema.is_built_for( opts ) )
     {
-      (void)e;
-      return false;
+      schema.build( opts );
     }
+
+    const auto* option = schema.find( name );
+    return option && option->count() > 0u;
   }
 
   /*! \brief Returns a store
@@ -538,6 +843,59 @@ public:
     env->set_default_option( store_info<T>::option );
   }
 
+  /*! \brief Declares the command as pure
+
+    The result of a pure command only depends on its arguments and on the
+    current elements of the stores it reads (see ``reads_store``).  The shell
+    then caches its executions: if the command is called again with the same
+    arguments while the stores it reads have not changed, it is not executed
+    again.  Instead, its output, its log, and its effect on the stores it
+    writes (see ``writes_store``) are replayed.  Commands that write to a
+    store that they also read change their own input, and are therefore never
+    cached.
+
+    Commands added with ``ALICE_PURE_COMMAND`` are declared pure automatically.
+
+    \param value Whether the command is pure
+  */
+  inline void set_pure( bool value = true )
+  {
+    pure = value;
+  }
+
+  /*! \brief Returns whether the command has been declared pure */
+  inline bool is_pure() const
+  {
+    return pure;
+  }
+
+  /*! \brief Declares that a command reads from a store
+
+    The store is locked for reading while the command runs, such that other
+    commands cannot write to it at the same time (e.g., in background jobs).
+    For pure commands, the store is also part of the cache key.  This
+    function should be called in the constructor.
+  */
+  template<typename Store>
+  void reads_store()
+  {
+    find_store_dependency<Store>().reads = true;
+  }
+
+  /*! \brief Declares that a command writes to a store
+
+    The store is locked for writing while the command runs.  For pure
+    commands, the effect of the command on the store must be to either append
+    elements to it or to replace the current element.  If a pure command also
+    depends on the store contents, it must be declared using ``reads_store``
+    as well.  This function should be called in the constructor.
+  */
+  template<typename Store>
+  void writes_store()
+  {
+    find_store_dependency<Store>().writes = true;
+  }
+
 /* A small hack to get the Python bindings to work */
 #if defined ALICE_PYTHON || defined ALICE_CINTERFACE
 public:
@@ -546,27 +904,165 @@ protected:
 #endif
   /*! \cond PRIVATE */
   virtual bool run( const std::vector<std::string>& args )
+  {
+    const auto result = run_tokens( args.begin(), args.end() );
+    env->command_finished();
+    return result;
+  }
+
+  /* runs the command on a range of tokens (strings or string views), the
+     first token is the command name */
+  template<typename Iterator>
+  bool run_tokens( Iterator begin, Iterator end )
+  {
+    return parse_tokens( begin, end ) && check_and_execute();
+  }
+
+  /* parses tokens into the options, the first token is the command name */
+  template<typename Iterator>
+  bool parse_tokens( Iterator begin, Iterator end )
+  {
+    /* arguments of the form @file are replaced by the lines of file */
+    for ( auto it = begin + 1; it != end; ++it )
+    {
+      if ( is_response_file( *it ) )
+      {
+        std::vector<std::unique_ptr<detail::mapped_file>> files;
+        std::vector<std::string_view> args;
+        if ( !expand_response_files( begin, end, files, args ) )
+        {
+          return false;
+        }
+        return parse_options( args.begin(), args.end() );
+      }
+    }
+
+    return parse_options( begin, end );
+  }
+
+  template<typename Iterator>
+  bool parse_options( Iterator begin, Iterator end )
   {
     opts.reset();
 
-    /* copy arguments (seems important to get the right grouping of arguments) */
-    std::vector<std::string> _args( args.size() - 1 );
-    std::transform( args.rbegin(), args.rend() - 1, _args.begin(), []( const auto& s ) {
-      if ( s.size() > 2 && s.front() == '"' && s.back() == '"' )
+    if ( !schema.is_built_for( opts ) )
+    {
+      schema.build( opts );
+    }
+
+    /* the schema handles common command lines, CLI11 handles the rest and reports errors */
+    if ( !schema.parse( begin + 1, end ) && !parse_with_cli11( begin, end ) )
+    {
+      return false;
+    }
+
+    if ( pure )
+    {
+      remember_option_values();
+    }
+    return true;
+  }
+
+  /* bound variables keep their values if an option is not given again, the
+     values of the last call that gave each option are part of the keys of
+     pure commands */
+  void remember_option_values()
+  {
+    const auto& all_options = detail::cli11_app_access::options( opts );
+    option_values.resize( all_options.size() );
+    for ( auto i = 0u; i < all_options.size(); ++i )
+    {
+      if ( all_options[i]->count() )
       {
-        return detail::unescape_quotes( s.substr( 1, s.size() - 2 ) );
+        option_values[i] = all_options[i]->results();
       }
+    }
+  }
 
-      const auto c_eq = s.find( '=' );
-      const auto c_q = s.find( '"' );
+  /* checks the rules and executes the command on the parsed options, while
+     the stores that the command reads and writes are locked */
+  bool check_and_execute()
+  {
+    const detail::dependency_locks locks( store_dependencies );
 
-      if ( c_eq != std::string::npos&& c_q != std::string::npos&& c_q == c_eq + 1 && s.back() == '"' )
+    for ( const auto& r : registered_rules )
+    {
+      if ( !r.validator() )
       {
-        return detail::unescape_quotes( s.substr( 0, c_eq + 1 ) + s.substr( c_q + 1, s.size() - c_q - 2 ) );
+        env->err() << "[e] " << r.message() << std::endl;
+        return false;
       }
+    }
 
-      return s;
-    } );
+    for ( const auto& p : validity_rules() )
+    {
+      if ( !p.first() )
+      {
+        env->err() << "[e] " << p.second << std::endl;
+        return false;
+      }
+    }
+
+    execute();
+    return true;
+  }
+
+  static bool is_response_file( std::string_view arg )
+  {
+    return arg.size() > 1u && arg.front() == '@';
+  }
+
+  /* copies the views of all tokens into args, and replaces each @file by the
+     non-empty lines of file (used verbatim, without tokenization) */
+  template<typename Iterator>
+  bool expand_response_files( Iterator begin, Iterator end, std::vector<std::unique_ptr<detail::mapped_file>>& files, std::vector<std::string_view>& args )
+  {
+    for ( auto it = begin; it != end; ++it )
+    {
+      const std::string_view arg = *it;
+      if ( it == begin || !is_response_file( arg ) )
+      {
+        args.push_back( arg );
+        continue;
+      }
+
+      const auto filename = detail::word_exp_filename( std::string( arg.substr( 1u ) ) );
+      const auto& file = files.emplace_back( std::make_unique<detail::mapped_file>( filename ) );
+      if ( !file->is_open() )
+      {
+        env->err() << "[e] cannot read response file " << filename << std::endl;
+        return false;
+      }
+
+      const auto contents = file->contents();
+      args.reserve( args.size() + std::count( contents.begin(), contents.end(), '\n' ) + 1u );
+      detail::for_each_line( contents, [&args]( auto line ) {
+        if ( !line.empty() && line.back() == '\r' )
+        {
+          line.remove_suffix( 1u );
+        }
+        if ( !line.empty() )
+        {
+          args.push_back( line );
+        }
+      } );
+    }
+    return true;
+  }
+
+  template<typename Iterator>
+  bool parse_with_cli11( Iterator begin, Iterator end )
+  {
+    opts.reset();
+
+    /* copy arguments in reverse order (seems important to get the right grouping of arguments) */
+    std::vector<std::string> _args;
+    _args.reserve( std::distance( begin, end ) );
+    std::string buffer;
+    for ( auto it = end; it != begin + 1; )
+    {
+      _args.emplace_back( detail::unquote_argument( *--it, buffer ) );
+    }
 
     try
     {
@@ -583,17 +1079,134 @@ protected:
       return false;
     }
 
-    for ( const auto& p : validity_rules() )
+    return true;
+  }
+
+  /* key for the cache of pure commands, empty if the execution cannot be cached */
+  template<typename Iterator>
+  std::string pure_key( Iterator begin, Iterator end ) const
+  {
+    std::string key = fmt::format( "{}", static_cast<const void*>( this ) );
+
+    for ( auto it = begin; it != end; ++it )
     {
-      if ( !p.first() )
+      const std::string_view arg = *it;
+      if ( it != begin && is_response_file( arg ) )
       {
-        env->err() << "[e] " << p.second << std::endl;
-        return false;
+        return {}; /* response files may change */
       }
+      key += '\0';
+      key += arg;
     }
 
-    execute();
-    return true;
+    for ( auto i = 0u; i < option_values.size(); ++i )
+    {
+      if ( !option_values[i].empty() )
+      {
+        key += fmt::format( "\1{}", i );
+        for ( const auto& value : option_values[i] )
+        {
+          key += '\0';
+          key += value;
+        }
+      }
+    }
+
+    for ( const auto& dep : store_dependencies )
+    {
+      if ( dep.reads && dep.writes )
+      {
+        return {}; /* the command changes its own input */
+      }
+      if ( dep.reads )
+      {
+        key += '\0';
+        key += std::to_string( dep.version() );
+        key += ':';
+        key += std::to_string( dep.current_index() );
+      }
+    }
+
+    return key;
+  }
+
+  /* runs a pure command and records its output, log, and store effects */
+  template<typename Iterator>
+  bool run_recorded( Iterator begin, Iterator end, detail::command_record& record )
+  {
+    /* the effects are recorded before other commands can change the stores */
+    const detail::dependency_locks locks( store_dependencies );
+
+    std::vector<uint64_t> versions;
+    std::vector<std::size_t> sizes;
+    for ( const auto& dep : store_dependencies )
+    {
+      versions.push_back( dep.version() );
+      sizes.push_back( dep.size() );
+    }
+
+    auto& out = *env->_out_sink.target();
+    auto& err = *env->_err_sink.target();
+    std::ostringstream out_buffer, err_buffer;
+
+    env->reroute( out_buffer, err_buffer );
+    try
+    {
+      record.result = run_tokens( begin, end );
+    }
+    catch ( ... )
+    {
+      env->reroute( out, err );
+      throw;
+    }
+    env->reroute( out, err );
+
+    record.out = out_buffer.str();
+    record.err = err_buffer.str();
+    env->out() << record.out;
+    env->err() << record.err;
+
+    for ( auto i = 0u; i < store_dependencies.size(); ++i )
+    {
+      const auto& dep = store_dependencies[i];
+      if ( dep.writes )
+      {
+        record.effects.push_back( dep.record( sizes[i] ) );
+      }
+      else
+      {
+        dep.restore_version( versions[i] ); /* only read by contract */
+      }
+    }
+
+    if ( record.result )
+    {
+      record.log = log();
+    }
+
+    return record.result;
+  }
+
+  /* replays a recorded execution of a pure command, the arguments are still
+     parsed such that the options are bound as if the command was executed */
+  template<typename Iterator>
+  void replay( Iterator begin, Iterator end, detail::command_record const& record )
+  {
+    parse_tokens( begin, end );
+
+    const detail::dependency_locks locks( store_dependencies );
+
+    env->out() << record.out;
+    env->err() << record.err;
+
+    auto effect = record.effects.begin();
+    for ( const auto& dep : store_dependencies )
+    {
+      if ( dep.writes )
+      {
+        dep.replay( *effect++ );
+      }
+    }
   }
   /*! \endcond */
 
@@ -603,13 +1216,44 @@ public:
 
 private:
   std::string scaption;
-  std::vector<std::any> options;
+  struct anonymous_option
+  {
+    CLI::Option* option;
+    std::any value;
+  };
+
+  std::deque<anonymous_option> options; /* deque such that bound values do not move */
   std::unordered_map<std::string, unsigned> option_index;
+  mutable detail::option_schema schema; /* built on first use */
+  std::vector<lazy_rule> registered_rules;
+  bool pure{false};
+  std::vector<std::vector<std::string>> option_values; /* values of the options in earlier calls, only for pure commands */
+  std::vector<detail::store_dependency> store_dependencies;
+
+private:
+  template<typename Store>
+  detail::store_dependency& find_store_dependency()
+  {
+    auto& store = env->store<Store>();
+    for ( auto& dep : store_dependencies )
+    {
+      if ( dep.store == &store )
+      {
+        return dep;
+      }
+    }
+    /* ordered by address, which is the order in which stores are locked */
+    const auto pos = std::find_if( store_dependencies.begin(), store_dependencies.end(), [&store]( auto const& dep ) { return std::less<const void*>()( &store, dep.store ); } );
+    return *store_dependencies.insert( pos, detail::make_store_dependency( store ) );
+  }
 
 private:
   template<typename... S>
   friend class cli;
 
+  template<typename... S>
+  friend class foreach_command;
+
   template<typename StoreType, typename Tag>
   friend bool can_read( command& cmd );
 
@@ -624,7 +1268,7 @@ private:
 };
 
 template<typename S>
-int add_option_helper( CLI::App& opts )
+CLI::Option* add_option_helper( CLI::App& opts )
 {
   constexpr auto option = store_info<S>::option;
   constexpr auto mnemonic = store_info<S>::mnemonic;
@@ -632,15 +1276,61 @@ int add_option_helper( CLI::App& opts )
 
   if ( strlen( mnemonic ) == 1u )
   {
-    opts.add_flag( fmt::format( "-{},--{}", mnemonic, option ), name_plural );
+    return opts.add_flag( fmt::format( "-{},--{}", mnemonic, option ), name_plural );
   }
   else
   {
-    opts.add_flag( fmt::format( "--{}", option ), name_plural );
+    return opts.add_flag( fmt::format( "--{}", option ), name_plural );
   }
+}
+
+namespace detail
+{
+
+/* position of T in Ts */
+template<typename T, typename... Ts>
+struct type_index;
+
+template<typename T, typename... Ts>
+struct type_index<T, T, Ts...> : std::integral_constant<std::size_t, 0u>
+{
+};
+
+template<typename T, typename U, typename... Ts>
+struct type_index<T, U, Ts...> : std::integral_constant<std::size_t, 1u + type_index<T, Ts...>::value>
+{
+};
+
+} // namespace detail
+
+/*! \brief Store flags of a command
+
+  Keeps the flags that select the stores ``S`` in a command (e.g., ``-s`` or
+  ``--str``), indexed by the position of the store type in ``S``.  Use
+  ``add_store_flag`` to add flags and ``is_store_set`` to check them.
+*/
+template<class... S>
+struct store_flags
+{
+  std::array<CLI::Option*, sizeof...( S )> options{};
+};
+
+/*! \brief Adds the flag for store type ``Store`` to a command */
+template<class Store, class... S>
+int add_store_flag( store_flags<S...>& flags, CLI::App& opts )
+{
+  flags.options[detail::type_index<Store, S...>::value] = add_option_helper<Store>( opts );
   return 0;
 }
 
+/*! \brief Checks whether the flag for store type ``Store`` was set */
+template<class Store, class... S>
+bool is_store_set( const store_flags<S...>& flags )
+{
+  const auto* option = flags.options[detail::type_index<Store, S...>::value];
+  return option && option->count() > 0u;
+}
+
 template<typename T>
 bool any_true_helper( std::initializer_list<T> list )
 {
@@ -43,16 +43,50 @@ public:
   explicit alias_command( const environment::ptr& env )
       : command( env, "Create command aliases" )
   {
-    add_option( "alias,--alias", alias, "regular expression for the alias" )->required();
-    add_option( "expansion,--expansion", expansion, "expansion for the alias" )->required();
+    add_option( "alias,--alias", alias, "regular expression for the alias" );
+    add_option( "expansion,--expansion", expansion, "expansion for the alias" );
+    add_flag( "--stats", "show statistics of the alias expansion cache" );
+
+    add_rule( [this]() { return is_set( "stats" ) || ( is_set( "alias" ) && is_set( "expansion" ) ); }, "alias and expansion need to be specified" );
   }
 
 protected:
   void execute()
   {
+    if ( is_set( "stats" ) )
+    {
+      const auto& cache = env->_alias_matcher.cache();
+      env->print( "[i] alias cache: {} hits, {} misses, {}/{} entries\n", cache.hits(), cache.misses(), cache.size(), cache.capacity() );
+      return;
+    }
+
+    try
+    {
+      env->_alias_matcher.insert( alias, expansion );
+    }
+    catch ( const std::regex_error& e )
+    {
+      env->err() << "[e] invalid alias " << alias << ": " << e.what() << std::endl;
+      return;
+    }
+
     env->_aliases[alias] = expansion;
   }
 
+  nlohmann::json log() const
+  {
+    if ( !is_set( "stats" ) )
+    {
+      return nullptr;
+    }
+
+    const auto& cache = env->_alias_matcher.cache();
+    return {
+        {"cache_hits", cache.hits()},
+        {"cache_misses", cache.misses()},
+        {"cache_size", cache.size()}};
+  }
+
 private:
   std::string alias;
   std::string expansion;
@@ -38,7 +38,7 @@ namespace alice
 {
 
 template<typename D, typename S>
-int add_combination_helper_inner( CLI::App& opts )
+CLI::Option* add_combination_helper_inner( CLI::App& opts )
 {
   if ( can_convert<S, D>() )
   {
@@ -48,35 +48,32 @@ int add_combination_helper_inner( CLI::App& opts )
     constexpr auto source_name = store_info<S>::name;
     constexpr auto dest_name = store_info<D>::name;
 
-    opts.add_flag( fmt::format( "--{}_to_{}", source_option, dest_option ),
-                   fmt::format( "convert {} to {}", source_name, dest_name ) );
+    return opts.add_flag( fmt::format( "--{}_to_{}", source_option, dest_option ),
+                          fmt::format( "convert {} to {}", source_name, dest_name ) );
   }
-  return 0;
+  return nullptr;
 }
 
+/* flags to convert into D, indexed by the position of the source store type in S */
 template<typename D, class... S>
-int add_combination_helper( CLI::App& opts )
+store_flags<S...> add_combination_helper( CLI::App& opts )
 {
-  []( ... ) {}( add_combination_helper_inner<D, S>( opts )... );
-  return 0;
+  return {{add_combination_helper_inner<D, S>( opts )...}};
 }
 
-template<typename D, class S>
-int convert_helper_inner( const environment::ptr& env, const command& cmd )
+template<typename D, class S, class... Ss>
+int convert_helper_inner( const environment::ptr& env, const store_flags<Ss...>& flags )
 {
   if ( can_convert<S, D>() )
   {
-    constexpr auto source_option = store_info<S>::option;
-    constexpr auto dest_option = store_info<D>::option;
-
-    if ( cmd.is_set( fmt::format( "{}_to_{}", source_option, dest_option ) ) )
+    if ( is_store_set<S>( flags ) )
     {
       constexpr auto source_name = store_info<S>::name;
       const auto& source_store = env->store<S>();
 
       if ( source_store.current_index() == -1 )
       {
-        std::cout << fmt::format( "[w] there is no {} to convert from", source_name ) << std::endl;
+        env->print( "[w] there is no {} to convert from\n", source_name );
         return 0;
       }
 
@@ -89,9 +86,9 @@ int convert_helper_inner( const environment::ptr& env, const command& cmd )
 }
 
 template<typename D, class... S>
-int convert_helper( const environment::ptr& env, const command& cmd )
+int convert_helper( const environment::ptr& env, const store_flags<S...>& flags )
 {
-  []( ... ) {}( convert_helper_inner<D, S>( env, cmd )... );
+  []( ... ) {}( convert_helper_inner<D, S>( env, flags )... );
   return 0;
 }
 
@@ -102,13 +99,19 @@ public:
   explicit convert_command( const environment::ptr& env )
       : command( env, "Convert store element into element of a different store" )
   {
-    []( ... ) {}( add_combination_helper<S, S...>( opts )... );
+    flags = {add_combination_helper<S, S...>( opts )...};
+
+    /* source and target are only known when the command runs */
+    []( ... ) {}( ( writes_store<S>(), 0 )... );
   }
 
 protected:
   void execute()
   {
-    []( ... ) {}( convert_helper<S, S...>( env, *this )... );
+    []( ... ) {}( convert_helper<S, S...>( env, flags[detail::type_index<S, S...>::value] )... );
   }
+
+private:
+  std::array<store_flags<S...>, sizeof...( S )> flags;
 };
 }
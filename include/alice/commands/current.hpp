@@ -46,19 +46,13 @@ public:
   {
     add_option( "index,--index", index, "new index" );
 
-    []( ... ) {}( add_option_helper<S>( opts )... );
-  }
-
-protected:
-  rules validity_rules() const
-  {
-    rules rules;
-
-    rules.push_back( {[this]() { (void)this; return env->has_default_option() || exactly_one_true_helper<bool>( {is_set( store_info<S>::option )...} ); }, "exactly one store needs to be specified"} );
+    []( ... ) {}( add_store_flag<S>( flags, opts )... );
+    []( ... ) {}( ( writes_store<S>(), 0 )... );
 
-    return rules;
+    add_rule( [this]() { return this->env->has_default_option() || exactly_one_true_helper<bool>( {is_store_set<S>( flags )...} ); }, "exactly one store needs to be specified" );
   }
 
+protected:
   void execute()
   {
     []( ... ) {}( set_current_index<S>()... );
@@ -70,7 +64,7 @@ private:
   {
     constexpr auto option = store_info<Store>::option;
 
-    if ( ( is_set( option ) || env->is_default_option( option ) ) && index < store<Store>().size() )
+    if ( ( is_store_set<Store>( flags ) || env->is_default_option( option ) ) && index < store<Store>().size() )
     {
       store<Store>().set_current_index( index );
       env->set_default_option( option );
@@ -80,5 +74,6 @@ private:
 
 private:
   unsigned index;
+  store_flags<S...> flags;
 };
 }
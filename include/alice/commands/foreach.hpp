@@ -0,0 +1,247 @@
+/* alice: C++ command shell library
+ * Copyright (C) 2017-2018  EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+  \file foreach.hpp
+  \brief Runs a command for each store element
+
+  \author Mathias Soeken
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "../command.hpp"
+#include "../detail/parallel.hpp"
+
+namespace alice
+{
+
+/* The command is parsed once, and executed for each element of the store,
+   where the element is made the current one through a private view, i.e.,
+   the current index of the store does not change.  With more than one job,
+   each worker thread has its own instance of the command and elements are
+   distributed dynamically; output is collected per element and printed in
+   order of the elements.  Commands that run in parallel must only access
+   the current element of the store.  The store is locked while the commands
+   run, for writing if the command declares to write it (see
+   ``writes_store``) and for reading otherwise, and commands that add or
+   remove elements fail.  A nested ``foreach`` runs on its own instance. */
+template<class... S>
+class foreach_command : public command
+{
+public:
+  explicit foreach_command( const environment::ptr& env )
+      : command( env, "Runs a command for each store element" )
+  {
+    []( ... ) {}( add_store_flag<S>( flags, opts )... );
+    add_option( "--jobs", jobs, "number of parallel jobs (0 uses all cores)", true );
+    opts.prefix_command();
+
+    add_rule( [this]() { return exactly_one_true_helper<bool>( {is_store_set<S>( flags )...} ); }, "exactly one store needs to be specified" );
+    add_rule( [this]() { return !opts.remaining().empty(); }, "no command specified" );
+  }
+
+protected:
+  void execute()
+  {
+    logs = nlohmann::json::array();
+    []( ... ) {}( foreach_store<S>()... );
+  }
+
+  nlohmann::json log() const
+  {
+    return nlohmann::json{{"elements", logs}};
+  }
+
+private:
+  template<typename Store>
+  int foreach_store()
+  {
+    if ( !is_store_set<Store>( flags ) )
+    {
+      return 0;
+    }
+
+    const auto args = opts.remaining();
+    const auto cmd = inner_command( args.front() );
+    if ( !cmd )
+    {
+      return 0;
+    }
+
+    /* the commands change their elements through private views, which do
+       not lock the store again */
+    auto& elements = store<Store>();
+    if ( writes( *cmd, &elements ) )
+    {
+      const auto guard = elements.write();
+      run_for_each( *cmd, args, &elements, elements.size() );
+    }
+    else
+    {
+      const auto guard = elements.read();
+      run_for_each( *cmd, args, &elements, elements.size() );
+    }
+    return 0;
+  }
+
+  /* the command that runs for each element, a nested foreach gets a new
+     instance, since this one is still executing */
+  std::shared_ptr<command> inner_command( const std::string& name )
+  {
+    const auto it = env->commands().find( name );
+    if ( it == env->commands().end() )
+    {
+      env->err() << "[e] unknown command: " << name << std::endl;
+      return nullptr;
+    }
+
+    if ( it->second.get() != this )
+    {
+      return it->second;
+    }
+
+    auto instance = env->create_command( name );
+    if ( !instance )
+    {
+      env->err() << "[e] command " << name << " cannot be nested" << std::endl;
+    }
+    return instance;
+  }
+
+  /* true, if cmd declares to write to store */
+  static bool writes( command const& cmd, const void* store )
+  {
+    return std::any_of( cmd.store_dependencies.begin(), cmd.store_dependencies.end(), [store]( auto const& dep ) { return dep.store == store && dep.writes; } );
+  }
+
+  void run_for_each( command& cmd, std::vector<std::string> const& args, const void* store, std::size_t size )
+  {
+    if ( !cmd.parse_tokens( args.begin(), args.end() ) )
+    {
+      return;
+    }
+
+    /* one command instance per worker */
+    std::vector<std::shared_ptr<command>> instances;
+    for ( auto worker = 1u; worker < detail::num_workers( jobs, size ); ++worker )
+    {
+      auto instance = env->create_command( args.front() );
+      if ( !instance )
+      {
+        env->err() << "[w] command " << args.front() << " cannot run in parallel" << std::endl;
+        instances.clear();
+        break;
+      }
+      instance->parse_tokens( args.begin(), args.end() );
+      instances.push_back( instance );
+    }
+
+    const auto parallel = !instances.empty();
+    std::vector<std::string> outputs( parallel ? size : 0u ), errors( parallel ? size : 0u );
+    std::vector<char> results( size );
+    std::vector<nlohmann::json> element_logs( size );
+
+    detail::parallel_for( size, instances.size() + 1u, [&]( std::size_t index, unsigned worker ) {
+      auto& instance = worker == 0u ? cmd : *instances[worker - 1u];
+
+      auto context = detail::this_thread_context();
+      context.view_store = store;
+      context.view_index = static_cast<int>( index );
+
+      if ( parallel )
+      {
+        std::ostringstream out, err;
+        context.worker = true;
+        context.out = &out;
+        context.err = &err;
+
+        detail::thread_context_guard guard( context );
+        results[index] = check_and_execute( instance );
+        outputs[index] = out.str();
+        errors[index] = err.str();
+      }
+      else
+      {
+        detail::thread_context_guard guard( context );
+        results[index] = check_and_execute( instance );
+      }
+
+      if ( results[index] )
+      {
+        element_logs[index] = instance.log();
+      }
+    } );
+
+    for ( auto index = 0u; index < size; ++index )
+    {
+      if ( parallel )
+      {
+        env->out() << outputs[index];
+        env->err() << errors[index];
+      }
+
+      nlohmann::json entry{{"index", index}, {"status", static_cast<bool>( results[index] )}};
+      if ( !element_logs[index].is_null() )
+      {
+        entry["log"] = std::move( element_logs[index] );
+      }
+      logs.push_back( std::move( entry ) );
+    }
+  }
+
+  /* runs the command for one element, the store rejects adding or removing
+     elements while the commands have views on them */
+  bool check_and_execute( command& instance )
+  {
+    try
+    {
+      return instance.check_and_execute();
+    }
+    catch ( const std::logic_error& e )
+    {
+      env->err() << "[e] " << e.what() << std::endl;
+      return false;
+    }
+  }
+
+private:
+  unsigned jobs{1u};
+  store_flags<S...> flags;
+  nlohmann::json logs;
+};
+
+} // namespace alice
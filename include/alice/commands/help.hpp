@@ -109,9 +109,7 @@ private:
 
       if ( !output.empty() )
       {
-        env->out() << "[i] found match in command \033[1;34m" << command.first << "\033[0m" << std::endl
-                   << output << std::endl
-                   << std::endl;
+        env->print( "[i] found match in command \033[1;34m{}\033[0m\n{}\n\n", command.first, output );
       }
     }
   }
@@ -120,7 +118,7 @@ private:
   {
     for ( auto& p : env->_categories )
     {
-      env->out() << p.first << " commands:" << std::endl;
+      env->print( "{} commands:\n", p.first );
 
       std::sort( p.second.begin(), p.second.end() );
 
@@ -128,27 +126,21 @@ private:
       {
         for ( const auto& name : p.second )
         {
-          env->out() << fmt::format( " {:<17} : {}", name, env->commands().at( name )->caption() ) << std::endl;
+          env->print( " {:<17} : {}\n", name, env->commands().at( name )->caption() );
         }
-        env->out() << std::endl;
+        env->print( "\n" );
       }
       else
       {
         auto counter = 0;
-        env->out() << " ";
+        env->print( " " );
 
         for ( const auto& name : p.second )
         {
-          if ( counter > 0 && ( counter % 4 == 0 ) )
-          {
-            env->out() << std::endl
-                       << " ";
-          }
-          env->out() << fmt::format( "{:<17}", name );
+          env->print( counter > 0 && ( counter % 4 == 0 ) ? "\n {:<17}" : "{:<17}", name );
           ++counter;
         }
-        env->out() << std::endl
-                   << std::endl;
+        env->print( "\n\n" );
       }
     }
   }
@@ -0,0 +1,137 @@
+/* alice: C++ command shell library
+ * Copyright (C) 2017-2018  EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+  \file jobs.hpp
+  \brief Commands to manage background jobs
+
+  \author Mathias Soeken
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "../command.hpp"
+
+namespace alice
+{
+
+/* Commands are started in the background with a trailing `&`, e.g.,
+   `read_aiger large.aig &`, and run on their own worker thread.  Their output
+   is shown when they have finished.  A job holds the locks of the stores that
+   its command declares, and write locks on all stores if it declares none. */
+class jobs_command : public command
+{
+public:
+  explicit jobs_command( const environment::ptr& env ) : command( env, "Lists background jobs" )
+  {
+  }
+
+protected:
+  void execute()
+  {
+    for ( const auto& job : env->_jobs.list() )
+    {
+      env->print( "[{}] {:<8} {}\n", job->id, status( *job ), job->line );
+    }
+  }
+
+  nlohmann::json log() const
+  {
+    auto jobs = nlohmann::json::array();
+    for ( const auto& job : env->_jobs.list() )
+    {
+      jobs.push_back( {{"id", job->id}, {"command", job->line}, {"status", status( *job )}} );
+    }
+    return nlohmann::json( {{"jobs", jobs}} );
+  }
+
+private:
+  static const char* status( detail::job const& job )
+  {
+    return job.cancelled ? "killed" : ( job.done ? "done" : "running" );
+  }
+};
+
+class wait_command : public command
+{
+public:
+  explicit wait_command( const environment::ptr& env ) : command( env, "Waits for background jobs" )
+  {
+    ids_option = add_option( "ids", ids, "job ids (waits for all jobs, if none is given)" );
+
+    add_rule( [this]() { return !ids_option->count() || std::all_of( ids.begin(), ids.end(), [this]( auto id ) { return this->env->_jobs.find( id ) != nullptr; } ); }, "job does not exist" );
+  }
+
+protected:
+  void execute()
+  {
+    if ( !ids_option->count() )
+    {
+      env->_jobs.wait_all();
+      return;
+    }
+
+    for ( auto id : ids )
+    {
+      env->_jobs.wait( *env->_jobs.find( id ) );
+    }
+  }
+
+private:
+  std::vector<unsigned> ids;
+  CLI::Option* ids_option;
+};
+
+class kill_command : public command
+{
+public:
+  explicit kill_command( const environment::ptr& env ) : command( env, "Cancels background jobs" )
+  {
+    add_option( "ids", ids, "job ids" )->required();
+    opts.set_footer( "Cancellation is cooperative: a job stops at the next env->cancelled() check of its command, and commands that do not check it run to completion." );
+
+    add_rule( [this]() { return std::all_of( ids.begin(), ids.end(), [this]( auto id ) { return this->env->_jobs.find( id ) != nullptr; } ); }, "job does not exist" );
+  }
+
+protected:
+  void execute()
+  {
+    for ( auto id : ids )
+    {
+      env->_jobs.find( id )->cancelled = true;
+    }
+  }
+
+private:
+  std::vector<unsigned> ids;
+};
+
+} // namespace alice
@@ -33,6 +33,7 @@
 #pragma once
 
 #include <sstream>
+#include <utility>
 
 #include "../command.hpp"
 
@@ -45,16 +46,13 @@ class print_command : public command
 public:
   explicit print_command( const environment::ptr& env ) : command( env, "Prints current data structure" )
   {
-    []( ... ) {}( add_option_helper<S>( opts )... );
-  }
+    []( ... ) {}( add_store_flag<S>( flags, opts )... );
+    []( ... ) {}( ( reads_store<S>(), 0 )... );
 
-protected:
-  rules validity_rules() const
-  {
-    return {
-        {[this]() { (void)this; return env->has_default_option() || exactly_one_true_helper<bool>( {is_set( store_info<S>::option )...} ); }, "exactly one store needs to be specified"}};
+    add_rule( [this]() { return this->env->has_default_option() || exactly_one_true_helper<bool>( {is_store_set<S>( flags )...} ); }, "exactly one store needs to be specified" );
   }
 
+protected:
   void execute()
   {
 #if !defined ALICE_PYTHON
@@ -78,16 +76,16 @@ private:
     constexpr auto option = store_info<Store>::option;
     constexpr auto name = store_info<Store>::name;
 
-    if ( is_set( option ) || env->is_default_option( option ) )
+    if ( is_store_set<Store>( flags ) || env->is_default_option( option ) )
     {
       if ( store<Store>().current_index() == -1 )
       {
-        env->out() << "[w] no " << name << " in store" << std::endl;
+        env->print( "[w] no {} in store\n", name );
         env->set_default_option( "" );
       }
       else
       {
-        print<Store>( env->out(), store<Store>().current() );
+        print<Store>( env->out(), std::as_const( store<Store>() ).current() );
         env->set_default_option( option );
       }
     }
@@ -100,7 +98,7 @@ private:
     constexpr auto option = store_info<Store>::option;
     constexpr auto name = store_info<Store>::name;
 
-    if ( is_set( option ) || env->is_default_option( option ) )
+    if ( is_store_set<Store>( flags ) || env->is_default_option( option ) )
     {
       if ( store<Store>().current_index() == -1 )
       {
@@ -109,16 +107,19 @@ private:
       else
       {
         std::stringstream strs;
-        print<Store>( strs, store<Store>().current() );
+        print<Store>( strs, std::as_const( store<Store>() ).current() );
         map["__repr__"] = strs.str();
 
         if ( has_html_repr<Store>() )
         {
-          map["_repr_html_"] = html_repr<Store>( store<Store>().current() );
+          map["_repr_html_"] = html_repr<Store>( std::as_const( store<Store>() ).current() );
         }
       }
     }
     return 0;
   }
+
+private:
+  store_flags<S...> flags;
 };
 }
@@ -32,6 +32,7 @@
 
 #pragma once
 
+#include <utility>
 #include <vector>
 
 #include <nlohmann/json.hpp>
@@ -48,25 +49,22 @@ public:
   explicit ps_command( const environment::ptr& env )
     : command( env, "Print statistics" )
   {
-    [](...){}( add_option_helper<S>( opts )... );
+    [](...){}( add_store_flag<S>( flags, opts )... );
+    [](...){}( ( reads_store<S>(), 0 )... );
     add_flag( "--all", "show statistics about all store entries" );
     add_flag( "--silent", "produce no output" );
-  }
 
-protected:
-  rules validity_rules() const
-  {
-    return {
-      {[this]() { (void)this; return env->has_default_option() || any_true_helper<bool>( { is_set( store_info<S>::option )... } ); }, "no store has been specified" }
-    };
+    add_rule( [this]() { return this->env->has_default_option() || any_true_helper<bool>( { is_store_set<S>( flags )... } ); }, "no store has been specified" );
   }
 
+protected:
   void execute()
   {
     has_option = false;
     [](...){}( check_option<S>()... );
 
-    if ( !is_set( "silent" ) )
+    /* the statistics are part of the log */
+    if ( !is_set( "silent" ) && !env->json_output() )
     {
       [](...){}( ps_store<S>()... );
     }
@@ -83,8 +81,7 @@ private:
   template<typename Store>
   int check_option()
   {
-    constexpr auto option = store_info<Store>::option;
-    if ( is_set( option ) )
+    if ( is_store_set<Store>( flags ) )
     {
       has_option = true;
     }
@@ -97,14 +94,14 @@ private:
     constexpr auto option = store_info<Store>::option;
     constexpr auto name   = store_info<Store>::name;
 
-    if ( is_set( option ) || ( !has_option && env->is_default_option( option ) ) )
+    if ( is_store_set<Store>( flags ) || ( !has_option && env->is_default_option( option ) ) )
     {
       if ( is_set( "all" ) )
       {
         auto ctr{0u};
         for ( const auto& elem : store<Store>().data() )
         {
-          env->out() << "[i] \033[1;34m" << name << "\033[0m \033[1;33m" << ctr++ << "\033[0m\n";
+          env->print( "[i] \033[1;34m{}\033[0m \033[1;33m{}\033[0m\n", name, ctr++ );
           print_statistics<Store>( env->out(), elem );
         }
         env->set_default_option( option );
@@ -113,12 +110,12 @@ private:
       {
         if ( store<Store>().current_index() == -1 )
         {
-          env->out() << "[w] no " << name << " in store" << std::endl;
+          env->print( "[w] no {} in store\n", name );
           env->set_default_option( "" );
         }
         else
         {
-          print_statistics<Store>( env->out(), store<Store>().current() );
+          print_statistics<Store>( env->out(), std::as_const( store<Store>() ).current() );
           env->set_default_option( option );
         }
       }
@@ -137,7 +134,7 @@ private:
 
     constexpr auto option = store_info<Store>::option;
 
-    if ( is_set( option ) || env->is_default_option( option ) )
+    if ( is_store_set<Store>( flags ) || env->is_default_option( option ) )
     {
       if ( is_set( "all" ) )
       {
@@ -152,7 +149,7 @@ private:
       {
         if ( store<Store>().current_index() != -1 )
         {
-          ret = log_statistics<Store>( store<Store>().current() );
+          ret = log_statistics<Store>( std::as_const( store<Store>() ).current() );
         }
       }
     }
@@ -162,6 +159,7 @@ private:
 
 private:
   bool has_option{false};
+  store_flags<S...> flags;
 };
 
 }
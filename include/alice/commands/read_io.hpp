@@ -32,12 +32,15 @@
 
 #pragma once
 
+#include <optional>
+#include <sstream>
 #include <string>
 #include <vector>
 
 #include <fmt/format.h>
 
 #include "../command.hpp"
+#include "../detail/parallel.hpp"
 #include "../detail/utils.hpp"
 #include "../validators.hpp"
 
@@ -57,27 +60,35 @@ public:
       default_option = allowed_options.front();
     }
 
-    add_option( "filename,--filename", filenames, "one or multiple filenames" )->check( ExistingFileWordExp )->required();
+    filename_option = add_option( "filename,--filename", filenames, "one or multiple filenames" )->check( ExistingFileWordExp );
     add_flag( "-n,--new", "create new store entry" );
-  }
-
-protected:
-  rules validity_rules() const
-  {
-    rules rules;
+    add_option( "--jobs", jobs, "number of parallel jobs to parse files (0 uses all cores)", true );
 
-    rules.push_back( {[this]() { return allowed_options.size() == 1 || env->has_default_option( allowed_options ) || exactly_one_true_helper( {is_set( store_info<S>::option )...} ); }, "exactly one store needs to be specified"} );
-
-    return rules;
+    /* the input is read from a pipe, if one is attached; `filenames` keeps
+       its value from earlier calls, therefore the option count is checked */
+    add_rule( [this]() { return filename_option->count() > 0u || this->env->pipe_input(); }, "filename is required" );
+    add_rule( [this]() { return allowed_options.size() == 1 || this->env->has_default_option( allowed_options ) || exactly_one_true_helper( {is_store_set<S>( flags )...} ); }, "exactly one store needs to be specified" );
   }
 
+protected:
   void execute()
   {
-    bool multiple{filenames.size() > 1};
+    if ( env->pipe_input() )
+    {
+      []( ... ) {}( read_pipe_helper<S>( *env->pipe_input() )... );
+      return;
+    }
+
+    std::vector<std::string> names;
     for ( const auto& filename : filenames )
     {
-      []( ... ) {}( read_io_helper<S>( multiple, detail::word_exp_filename( filename ) )... );
+      for ( auto& name : detail::split( detail::word_exp_filename( filename ), " " ) )
+      {
+        names.push_back( std::move( name ) );
+      }
     }
+
+    []( ... ) {}( read_io_helper<S>( names )... );
   }
 
 private:
@@ -89,42 +100,134 @@ private:
       constexpr auto option = store_info<Store>::option;
 
       allowed_options.push_back( option );
-      add_option_helper<Store>( opts );
+      add_store_flag<Store>( flags, opts );
+      writes_store<Store>();
     }
 
     return 0;
   }
 
+  /* Files are parsed on up to `jobs` threads, and the elements are moved
+     into the store in the order of the files afterwards.  With more than one
+     job, the output of `read` is collected per file and printed in the same
+     order.  Errors are reported together after all files have been read. */
   template<typename Store>
-  int read_io_helper( bool multiple, const std::string& filename )
+  int read_io_helper( std::vector<std::string> const& names )
   {
     constexpr auto option = store_info<Store>::option;
 
-    if ( is_set( option ) || option == default_option || env->is_default_option( option ) )
+    if ( is_store_set<Store>( flags ) || option == default_option || env->is_default_option( option ) )
     {
-      const auto names = detail::split( filename, " " );
+      /* is_set builds the option schema on first use, which must happen
+         here, before the workers call `read` (which may query options) */
+      const bool new_entry = is_set( "new" );
+      const auto extend = names.size() > 1u || new_entry;
+      const auto workers = detail::num_workers( jobs, names.size() );
+
+      std::vector<std::optional<Store>> elements( names.size() );
+      std::vector<std::string> errors( names.size() );
+      std::vector<std::string> outputs( workers > 1u ? names.size() : 0u ), error_outputs( outputs.size() );
+
+      detail::parallel_for( names.size(), workers, [&]( std::size_t index, unsigned ) {
+        std::ostringstream out, err;
+        auto context = detail::this_thread_context();
+        if ( workers > 1u )
+        {
+          context.worker = true;
+          context.out = &out;
+          context.err = &err;
+        }
+        detail::thread_context_guard guard( context );
 
-      for ( const auto& name : names )
-      {
         try
         {
-          const auto element = read<Store, Tag>( name, static_cast<command const&>( *this ) );
-
-          if ( multiple || names.size() > 1 || is_set( "new" ) || env->store<Store>().empty() )
-          {
-            env->store<Store>().extend();
-          }
-
-          env->store<Store>().current() = element;
+          elements[index] = read<Store, Tag>( names[index], static_cast<command const&>( *this ) );
         }
         catch ( const std::string& error )
         {
-          env->err() << "[e] " << error << "\n";
+          errors[index] = error;
         }
         catch ( ... )
         {
           /* do nothing, user should display error or warning in `read` function */
         }
+
+        if ( workers > 1u )
+        {
+          outputs[index] = out.str();
+          error_outputs[index] = err.str();
+        }
+      } );
+
+      auto& store = env->store<Store>();
+      auto failed = 0u;
+      for ( auto index = 0u; index < names.size(); ++index )
+      {
+        if ( workers > 1u )
+        {
+          env->out() << outputs[index];
+          env->err() << error_outputs[index];
+        }
+
+        if ( !elements[index] )
+        {
+          ++failed;
+          continue;
+        }
+
+        if ( extend || store.empty() )
+        {
+          store.extend( std::move( *elements[index] ) );
+        }
+        else
+        {
+          store.current() = std::move( *elements[index] );
+        }
+      }
+
+      for ( const auto& error : errors )
+      {
+        if ( !error.empty() )
+        {
+          env->err() << "[e] " << error << "\n";
+        }
+      }
+      if ( failed && names.size() > 1u )
+      {
+        env->err() << fmt::format( "[e] {} of {} files could not be read\n", failed, names.size() );
+      }
+
+      env->set_default_option( option );
+    }
+    return 0;
+  }
+
+  template<typename Store>
+  int read_pipe_helper( std::istream& is )
+  {
+    constexpr auto option = store_info<Store>::option;
+    constexpr auto name = store_info<Store>::name;
+
+    if ( is_store_set<Store>( flags ) || option == default_option || env->is_default_option( option ) )
+    {
+      try
+      {
+        const auto element = read<Store, Tag>( is, static_cast<command const&>( *this ) );
+
+        if ( is_set( "new" ) || env->store<Store>().empty() )
+        {
+          env->store<Store>().extend();
+        }
+
+        env->store<Store>().current() = element;
+      }
+      catch ( const std::string& error )
+      {
+        env->err() << "[e] " << error << "\n";
+      }
+      catch ( ... )
+      {
+        env->err() << "[e] cannot read " << name << " from pipe\n";
       }
 
       env->set_default_option( option );
@@ -134,7 +237,10 @@ private:
 
 private:
   std::vector<std::string> filenames;
+  CLI::Option* filename_option;
   std::vector<std::string> allowed_options;
   std::string default_option;
+  unsigned jobs{1u};
+  store_flags<S...> flags;
 };
 }
@@ -40,6 +40,7 @@
 #include <cstdio>
 #include <string>
 #include <unordered_map>
+#include <utility>
 
 #include <fmt/format.h>
 
@@ -65,18 +66,11 @@ public:
     add_option( "--program", program, "program to open file", true );
     add_flag( "--silent", "do not open file" );
     add_flag( "--delete", "delete file after showing (program must run in foreground)" );
-  }
-
-protected:
-  rules validity_rules() const
-  {
-    rules rules;
-
-    rules.push_back( {[this]() { return option_count == 1 || env->has_default_option() || exactly_one_true_helper<bool>( {is_set( store_info<S>::option )...} ); }, "exactly one store needs to be specified"} );
 
-    return rules;
+    add_rule( [this]() { return option_count == 1 || this->env->has_default_option() || exactly_one_true_helper<bool>( {is_store_set<S>( flags )...} ); }, "exactly one store needs to be specified" );
   }
 
+protected:
   void execute()
   {
     [](...){}( show_store<S>()... );
@@ -93,7 +87,8 @@ private:
 
       option_count++;
       default_option = option;
-      add_option_helper<Store>( opts );
+      add_store_flag<Store>( flags, opts );
+      reads_store<Store>();
 
       extensions[option] = extension;
     }
@@ -106,11 +101,11 @@ private:
     constexpr auto option = store_info<Store>::option;
     constexpr auto name = store_info<Store>::name;
 
-    if ( is_set( option ) || default_option == option || env->is_default_option( option ) )
+    if ( is_store_set<Store>( flags ) || default_option == option || env->is_default_option( option ) )
     {
       if ( store<Store>().current_index() == -1 )
       {
-        env->out() << "[w] no " << name << " in store" << std::endl;
+        env->print( "[w] no {} in store\n", name );
         env->set_default_option( "" );
       }
       else
@@ -129,7 +124,7 @@ private:
         }
 
         std::ofstream os( filename.c_str(), std::ofstream::out );
-        show<Store>( os, store<Store>().current(), *this );
+        show<Store>( os, std::as_const( store<Store>() ).current(), *this );
         os.close();
 
         if ( !is_set( "silent" ) )
@@ -161,6 +156,7 @@ private:
   std::unordered_map<std::string, std::string> extensions;
   unsigned option_count = 0u;
   std::string default_option;
+  store_flags<S...> flags;
 };
 
 }
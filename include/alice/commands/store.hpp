@@ -32,6 +32,8 @@
 
 #pragma once
 
+#include <algorithm>
+#include <string>
 #include <vector>
 
 #include <fmt/format.h>
@@ -52,19 +54,18 @@ public:
     add_flag( "--clear", "clear contents" );
     add_flag( "--pop", "pop current element" );
 
-    []( ... ) {}( add_option_helper<S>( opts )... );
-  }
+    []( ... ) {}( add_store_flag<S>( flags, opts )... );
+    []( ... ) {}( ( writes_store<S>(), 0 )... );
 
-protected:
-  rules validity_rules() const
-  {
-    return {
-        {[this]() { return static_cast<unsigned>( is_set( "show" ) ) + static_cast<unsigned>( is_set( "clear" ) ) <= 1u; }, "only one operation can be specified"},
-        {[this]() { (void)this; return env->has_default_option() || any_true_helper<bool>( {is_set( store_info<S>::option )...} ); }, "no store has been specified"}};
+    add_rule( [this]() { return static_cast<unsigned>( is_set( "show" ) ) + static_cast<unsigned>( is_set( "clear" ) ) <= 1u; }, "only one operation can be specified" );
+    add_rule( [this]() { return this->env->has_default_option() || any_true_helper<bool>( {is_store_set<S>( flags )...} ); }, "no store has been specified" );
   }
 
+protected:
   void execute()
   {
+    shown.clear();
+
     if ( is_set( "show" ) || ( !is_set( "clear" ) && !( is_set( "pop" ) ) ) )
     {
       []( ... ) {}( show_store<S>()... );
@@ -96,20 +97,24 @@ private:
 
     const auto& _store = store<Store>();
 
-    if ( is_set( option ) || env->is_default_option( option ) )
+    if ( is_store_set<Store>( flags ) || env->is_default_option( option ) )
     {
       if ( _store.empty() )
       {
-        env->out() << fmt::format( "[w] no {} in store", name ) << std::endl;
+        env->print( "[w] no {} in store\n", name );
+      }
+      else if ( env->json_output() )
+      {
+        /* the contents are part of the log */
+        shown.push_back( option );
       }
       else
       {
-        env->out() << fmt::format( "[i] {} in store:", name_plural ) << std::endl;
+        env->print( "[i] {} in store:\n", name_plural );
         auto index = 0;
         for ( const auto& element : _store.data() )
         {
-          env->out() << fmt::format( "  {} {:2}: ", ( _store.current_index() == index ? '*' : ' ' ), index );
-          env->out() << to_string<Store>( element ) << std::endl;
+          env->print( "  {} {:2}: {}\n", ( _store.current_index() == index ? '*' : ' ' ), index, to_string<Store>( element ) );
           ++index;
         }
       }
@@ -125,7 +130,7 @@ private:
   {
     constexpr auto option = store_info<Store>::option;
 
-    if ( is_set( option ) || env->is_default_option( option ) )
+    if ( is_store_set<Store>( flags ) || env->is_default_option( option ) )
     {
       store<Store>().clear();
       env->set_default_option( option );
@@ -138,7 +143,7 @@ private:
   {
     constexpr auto option = store_info<Store>::option;
 
-    if ( is_set( option ) || env->is_default_option( option ) )
+    if ( is_store_set<Store>( flags ) || env->is_default_option( option ) )
     {
       store<Store>().pop_current();
       env->set_default_option( option );
@@ -151,11 +156,24 @@ private:
   {
     constexpr auto option = store_info<Store>::option;
 
-    if ( is_set( option ) || env->is_default_option( option ) )
+    if ( is_store_set<Store>( flags ) || env->is_default_option( option ) )
     {
       map[option] = store<Store>().current_index();
+
+      if ( std::find( shown.begin(), shown.end(), option ) != shown.end() )
+      {
+        auto& contents = map["contents"][option] = nlohmann::json::array();
+        for ( const auto& element : store<Store>().data() )
+        {
+          contents.push_back( to_string<Store>( element ) );
+        }
+      }
     }
     return 0;
   }
+
+private:
+  store_flags<S...> flags;
+  std::vector<std::string> shown; /* stores whose contents are logged (JSON output) */
 };
 }
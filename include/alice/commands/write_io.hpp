@@ -33,6 +33,7 @@
 #pragma once
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <fmt/format.h>
@@ -57,21 +58,14 @@ public:
 
     add_option( "filename,--filename", filename, "filename" );
     add_flag( "--log", "write file contents to log instead of filename" );
-  }
-
-protected:
-  rules validity_rules() const
-  {
-    rules rules;
-
-    rules.push_back( {[this]() { return allowed_options.size() == 1 || env->has_default_option( allowed_options ) || exactly_one_true_helper( {is_set( store_info<S>::option )...} ); }, "exactly one store needs to be specified"} );
 
-    return rules;
+    add_rule( [this]() { return allowed_options.size() == 1 || this->env->has_default_option( allowed_options ) || exactly_one_true_helper( {is_store_set<S>( flags )...} ); }, "exactly one store needs to be specified" );
   }
 
+protected:
   void execute()
   {
-    if ( exactly_one_true_helper( {is_set( store_info<S>::option )...} ) )
+    if ( exactly_one_true_helper( {is_store_set<S>( flags )...} ) )
     {
       env->set_default_option( "" );
     }
@@ -99,7 +93,8 @@ private:
       constexpr auto option = store_info<Store>::option;
 
       allowed_options.push_back( option );
-      add_option_helper<Store>( opts );
+      add_store_flag<Store>( flags, opts );
+      reads_store<Store>();
     }
 
     return 0;
@@ -111,30 +106,48 @@ private:
     constexpr auto option = store_info<Store>::option;
     constexpr auto name = store_info<Store>::name;
 
-    if ( is_set( option ) || option == default_option || env->is_default_option( option ) )
+    if ( is_store_set<Store>( flags ) || option == default_option || env->is_default_option( option ) )
     {
       if ( env->store<Store>().current_index() == -1 )
       {
-        env->out() << "[w] no " << name << " selected in store" << std::endl;
+        env->print( "[w] no {} selected in store\n", name );
         env->set_default_option( "" );
+
+        if ( auto* os = env->pipe_output() )
+        {
+          os->setstate( std::ios_base::badbit );
+        }
+      }
+      else if ( auto* os = env->pipe_output() )
+      {
+        try
+        {
+          write<Store, Tag>( std::as_const( env->store<Store>() ).current(), *os, static_cast<command const&>( *this ) );
+        }
+        catch ( ... )
+        {
+          env->err() << "[e] cannot write " << name << " to pipe" << std::endl;
+          os->setstate( std::ios_base::badbit );
+        }
+        env->set_default_option( option );
       }
       else if ( is_set( "--log" ) )
       {
         try
         {
           std::ostringstream os;
-          write<Store, Tag>( env->store<Store>().current(), os, static_cast<command const&>( *this ) );
+          write<Store, Tag>( std::as_const( env->store<Store>() ).current(), os, static_cast<command const&>( *this ) );
           contents = os.str();
         }
         catch ( ... )
         {
-          env->out() << "[w] writing to log is not supported for this command" << std::endl;
+          env->print( "[w] writing to log is not supported for this command\n" );
         }
         env->set_default_option( option );
       }
       else
       {
-        write<Store, Tag>( env->store<Store>().current(), filename, static_cast<command const&>( *this ) );
+        write<Store, Tag>( std::as_const( env->store<Store>() ).current(), filename, static_cast<command const&>( *this ) );
         env->set_default_option( option );
       }
     }
@@ -146,5 +159,6 @@ private:
   std::string contents;
   std::vector<std::string> allowed_options;
   std::string default_option;
+  store_flags<S...> flags;
 };
 }
@@ -0,0 +1,187 @@
+/* alice: C++ command shell library
+ * Copyright (C) 2017-2018  EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+  \file alias_matcher.hpp
+  \brief Precompiled alias patterns
+
+  \author Mathias Soeken
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lru_cache.hpp"
+#include "utils.hpp"
+
+namespace alice
+{
+
+namespace detail
+{
+
+/* Matches lines against alias patterns
+
+   Each pattern is compiled into a regular expression once when the alias is
+   added.  The literal prefix of a pattern (the characters before the first
+   special character) must be a prefix of every line it matches, which allows
+   to skip most patterns without running the regular expression.  Patterns are
+   tried in the order in which they have been added.
+
+   The matcher also holds a cache for complete expansions of lines, which is
+   cleared whenever an alias is added or changed.
+*/
+class alias_matcher
+{
+public:
+  /* adds an alias or replaces the expansion of an existing one, throws
+     `std::regex_error` if pattern is not a valid regular expression */
+  void insert( const std::string& pattern, const std::string& expansion )
+  {
+    for ( auto& e : _entries )
+    {
+      if ( e.pattern == pattern )
+      {
+        if ( e.expansion != expansion )
+        {
+          e.expansion = expansion;
+          changed();
+        }
+        return;
+      }
+    }
+
+    std::regex regex( pattern, std::regex::ECMAScript | std::regex::optimize );
+    _entries.push_back( {pattern, literal_prefix( pattern ), std::move( regex ), expansion} );
+    changed();
+  }
+
+  inline bool empty() const
+  {
+    return _entries.empty();
+  }
+
+  /* changes whenever an alias is added or changed */
+  inline uint64_t generation() const
+  {
+    return _generation;
+  }
+
+  /* complete expansions of lines */
+  inline lru_cache<std::string>& cache()
+  {
+    return _cache;
+  }
+
+  inline const lru_cache<std::string>& cache() const
+  {
+    return _cache;
+  }
+
+  /* expands line with the first matching alias (one step), returns false if
+     no alias matches */
+  bool expand( std::string_view line, std::string& result ) const
+  {
+    std::match_results<std::string_view::const_iterator> m;
+
+    for ( const auto& e : _entries )
+    {
+      if ( line.compare( 0u, e.prefix.size(), e.prefix ) != 0 )
+      {
+        continue;
+      }
+
+      if ( std::regex_match( line.begin(), line.end(), m, e.regex ) )
+      {
+        std::vector<std::string> matches( m.size() - 1u );
+
+        for ( auto i = 0u; i < matches.size(); ++i )
+        {
+          matches[i] = m[i + 1].str();
+        }
+
+        result = trim_copy( format_with_vector( e.expansion, matches ) );
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+private:
+  static std::string literal_prefix( std::string_view pattern )
+  {
+    /* alternatives may start with different characters */
+    if ( pattern.find( '|' ) != std::string_view::npos )
+    {
+      return {};
+    }
+
+    constexpr std::string_view special = "\\^$.|?*+()[]{}";
+
+    std::string prefix;
+    for ( auto c : pattern )
+    {
+      if ( special.find( c ) != std::string_view::npos )
+      {
+        /* these quantifiers make the previous character optional */
+        if ( ( c == '?' || c == '*' || c == '{' ) && !prefix.empty() )
+        {
+          prefix.pop_back();
+        }
+        break;
+      }
+      prefix += c;
+    }
+    return prefix;
+  }
+
+private:
+  struct entry
+  {
+    std::string pattern;
+    std::string prefix;
+    std::regex regex;
+    std::string expansion;
+  };
+
+  void changed()
+  {
+    _cache.clear();
+    ++_generation;
+  }
+
+  std::vector<entry> _entries;
+  lru_cache<std::string> _cache;
+  uint64_t _generation{0u};
+};
+
+} // namespace detail
+} // namespace alice
@@ -0,0 +1,156 @@
+/* alice: C++ command shell library
+ * Copyright (C) 2017-2018  EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+  \file command_cache.hpp
+  \brief Recorded executions of pure commands
+
+  \author Mathias Soeken
+*/
+
+#pragma once
+
+#include <any>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "../store.hpp"
+
+namespace alice
+{
+
+namespace detail
+{
+
+/* Type-erased access to a store that a command reads or writes */
+struct store_dependency
+{
+  const void* store;
+  std::shared_mutex* mutex;
+  bool reads;
+  bool writes;
+
+  std::function<uint64_t()> version;
+  std::function<int()> current_index;
+  std::function<void( uint64_t )> restore_version;
+  std::function<std::size_t()> size;
+  std::function<std::any( std::size_t )> record; /* effect of a command, given the store size before its execution */
+  std::function<void( std::any const& )> replay;
+};
+
+/* Effect of a command on a store
+
+   Either the elements that have been appended to the store, or, if there are
+   none, the new value of the current element.
+*/
+template<typename T>
+struct store_effect
+{
+  std::vector<T> appended;
+  std::optional<T> current;
+};
+
+template<typename T>
+store_dependency make_store_dependency( store_container<T>& store )
+{
+  store_dependency dep{&store, &store.mutex(), false, false, {}, {}, {}, {}, {}, {}};
+
+  dep.version = [&store]() { return store.version(); };
+  dep.current_index = [&store]() { return store.current_index(); };
+  dep.restore_version = [&store]( uint64_t version ) { store.restore_version( version ); };
+  dep.size = [&store]() { return store.size(); };
+  dep.record = [&store]( std::size_t size_before ) {
+    store_effect<T> effect;
+    if ( store.size() > size_before )
+    {
+      effect.appended.assign( store.data().begin() + size_before, store.data().end() );
+    }
+    else if ( store.current_index() >= 0 )
+    {
+      effect.current = std::as_const( store ).current();
+    }
+    return std::any( std::move( effect ) );
+  };
+  dep.replay = [&store]( std::any const& any ) {
+    const auto& effect = std::any_cast<store_effect<T> const&>( any );
+    for ( const auto& element : effect.appended )
+    {
+      store.extend( element );
+    }
+    if ( effect.current )
+    {
+      store.extend_if_empty() = *effect.current;
+    }
+  };
+
+  return dep;
+}
+
+/* Locks the stores of dependencies for the lifetime of the object
+
+   The dependencies must be ordered by the addresses of their stores (as in
+   `command`), such that commands that run at the same time lock stores in
+   the same order and cannot deadlock. */
+class dependency_locks
+{
+public:
+  explicit dependency_locks( std::vector<store_dependency> const& dependencies )
+  {
+    if ( dependencies.empty() )
+    {
+      return;
+    }
+
+    locks.reserve( dependencies.size() );
+    for ( const auto& dep : dependencies )
+    {
+      locks.emplace_back( dep.store, *dep.mutex, dep.writes );
+    }
+  }
+
+private:
+  std::vector<store_lock> locks;
+};
+
+/* Recorded execution of a pure command */
+struct command_record
+{
+  bool result{false};
+  std::string out;
+  std::string err;
+  nlohmann::json log;
+  std::vector<std::any> effects; /* one for each written store */
+};
+
+} // namespace detail
+} // namespace alice
@@ -0,0 +1,310 @@
+/* alice: C++ command shell library
+ * Copyright (C) 2017-2018  EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+  \file command_table.hpp
+  \brief Compile-time perfect hash table for command dispatch
+
+  \author Mathias Soeken
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+namespace alice
+{
+
+class command;
+
+namespace detail
+{
+
+/* FNV-1a hash of a command name */
+constexpr uint32_t command_hash( std::string_view key )
+{
+  uint32_t h = 2166136261u;
+  for ( auto c : key )
+  {
+    h ^= static_cast<uint8_t>( c );
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/* derives a second hash from a key hash and a seed (finalizer from MurmurHash3) */
+constexpr uint32_t command_rehash( uint32_t h, uint32_t seed )
+{
+  h ^= seed * 0x9e3779b9u;
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+/* slot of a key with hash h, given the displacements of a perfect hash table
+   (see `perfect_hash`) */
+template<typename Displacements>
+constexpr int32_t perfect_hash_slot( uint32_t h, Displacements const& displacements, uint32_t mask )
+{
+  const auto d = displacements[command_rehash( h, 0u ) & mask];
+  return d < 0 ? -d - 1 : static_cast<int32_t>( command_rehash( h, static_cast<uint32_t>( d ) ) & mask );
+}
+
+constexpr std::size_t perfect_hash_size( std::size_t n )
+{
+  /* power of two with a load factor of at most 1/2 */
+  std::size_t size = 2u;
+  while ( size < 2u * n )
+  {
+    size <<= 1u;
+  }
+  return size;
+}
+
+/* Perfect hash table in hash-and-displace style
+
+   A key is first hashed into a bucket.  Each bucket stores either a seed for
+   a second hash function (positive value) or the final slot directly
+   (negative value).  All keys of a bucket are placed with the same seed.  The
+   second hash function is derived from the first one, such that the key is
+   only traversed once.
+*/
+template<std::size_t N>
+struct perfect_hash
+{
+  static constexpr std::size_t size = perfect_hash_size( N );
+  static constexpr uint32_t mask = static_cast<uint32_t>( size - 1u );
+
+  std::array<std::string_view, size> keys{};
+  std::array<int32_t, size> displacements{};
+
+  constexpr int32_t slot( std::string_view key ) const
+  {
+    const auto s = perfect_hash_slot( command_hash( key ), displacements, mask );
+    return ( !key.empty() && keys[s] == key ) ? s : -1;
+  }
+};
+
+/* builds the table, duplicate and empty keys are ignored */
+template<std::size_t N>
+constexpr perfect_hash<N> make_perfect_hash( std::array<std::string_view, N> const& names )
+{
+  using table_t = perfect_hash<N>;
+  constexpr auto size = table_t::size;
+  constexpr auto mask = table_t::mask;
+
+  table_t table{};
+
+  /* unique keys grouped by bucket */
+  std::array<std::string_view, N + 1u> keys{};
+  std::array<uint32_t, N + 1u> hashes{};
+  std::array<uint32_t, N + 1u> bucket_of{};
+  std::size_t num_keys = 0u;
+  for ( std::size_t i = 0u; i < N; ++i )
+  {
+    auto duplicate = names[i].empty();
+    for ( std::size_t j = 0u; j < num_keys && !duplicate; ++j )
+    {
+      duplicate = keys[j] == names[i];
+    }
+    if ( !duplicate )
+    {
+      hashes[num_keys] = command_hash( names[i] );
+      bucket_of[num_keys] = command_rehash( hashes[num_keys], 0u ) & mask;
+      keys[num_keys++] = names[i];
+    }
+  }
+
+  std::array<std::size_t, size> bucket_size{};
+  for ( std::size_t i = 0u; i < num_keys; ++i )
+  {
+    ++bucket_size[bucket_of[i]];
+  }
+
+  /* buckets ordered by decreasing size */
+  std::array<std::size_t, size> order{};
+  for ( std::size_t b = 0u; b < size; ++b )
+  {
+    order[b] = b;
+  }
+  for ( std::size_t i = 1u; i < size; ++i )
+  {
+    for ( std::size_t j = i; j > 0u && bucket_size[order[j - 1u]] < bucket_size[order[j]]; --j )
+    {
+      const auto tmp = order[j];
+      order[j] = order[j - 1u];
+      order[j - 1u] = tmp;
+    }
+  }
+
+  std::array<bool, size> used{};
+  std::size_t next_free = 0u;
+
+  for ( std::size_t o = 0u; o < size; ++o )
+  {
+    const auto b = order[o];
+    if ( bucket_size[b] == 0u )
+    {
+      break;
+    }
+
+    if ( bucket_size[b] == 1u )
+    {
+      while ( used[next_free] )
+      {
+        ++next_free;
+      }
+
+      for ( std::size_t i = 0u; i < num_keys; ++i )
+      {
+        if ( bucket_of[i] == b )
+        {
+          used[next_free] = true;
+          table.keys[next_free] = keys[i];
+          table.displacements[b] = -static_cast<int32_t>( next_free ) - 1;
+        }
+      }
+      continue;
+    }
+
+    for ( uint32_t d = 1u;; ++d )
+    {
+      if ( d == ( 1u << 20u ) )
+      {
+        throw std::logic_error( "cannot create perfect hash for command names" );
+      }
+
+      std::array<std::size_t, N + 1u> slots{};
+      std::size_t placed = 0u;
+      auto ok = true;
+      for ( std::size_t i = 0u; i < num_keys && ok; ++i )
+      {
+        if ( bucket_of[i] != b )
+        {
+          continue;
+        }
+
+        const auto s = command_rehash( hashes[i], d ) & mask;
+        ok = !used[s];
+        for ( std::size_t j = 0u; j < placed && ok; ++j )
+        {
+          ok = slots[j] != s;
+        }
+        slots[placed++] = s;
+      }
+
+      if ( ok )
+      {
+        placed = 0u;
+        for ( std::size_t i = 0u; i < num_keys; ++i )
+        {
+          if ( bucket_of[i] == b )
+          {
+            used[slots[placed]] = true;
+            table.keys[slots[placed++]] = keys[i];
+          }
+        }
+        table.displacements[b] = static_cast<int32_t>( d );
+        break;
+      }
+    }
+  }
+
+  return table;
+}
+
+/* Run-time view on a perfect hash table that maps keys to commands
+
+   The table is filled once from a `perfect_hash` (computed at compile time) and
+   a lookup costs one hash computation and one string comparison.  Keys that
+   are not part of the table must be resolved by the caller.
+*/
+class command_table
+{
+public:
+  template<std::size_t N>
+  void assign( perfect_hash<N> const& table )
+  {
+    keys.assign( table.keys.begin(), table.keys.end() );
+    displacements.assign( table.displacements.begin(), table.displacements.end() );
+    commands.assign( keys.size(), nullptr );
+    mask = perfect_hash<N>::mask;
+  }
+
+  /* sets the command for key, if key is part of the table */
+  void update( std::string_view key, command* cmd )
+  {
+    if ( const auto s = slot( key ); s >= 0 )
+    {
+      commands[s] = cmd;
+    }
+  }
+
+  command* find( std::string_view key ) const
+  {
+    const auto s = slot( key );
+    return s >= 0 ? commands[s] : nullptr;
+  }
+
+  bool empty() const
+  {
+    return keys.empty();
+  }
+
+  void clear()
+  {
+    keys.clear();
+    displacements.clear();
+    commands.clear();
+  }
+
+private:
+  int32_t slot( std::string_view key ) const
+  {
+    if ( keys.empty() )
+    {
+      return -1;
+    }
+
+    const auto s = perfect_hash_slot( command_hash( key ), displacements, mask );
+    return ( !key.empty() && keys[s] == key ) ? s : -1;
+  }
+
+private:
+  std::vector<std::string_view> keys;
+  std::vector<int32_t> displacements;
+  std::vector<command*> commands;
+  uint32_t mask{0u};
+};
+
+} // namespace detail
+} // namespace alice
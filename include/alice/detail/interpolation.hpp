@@ -0,0 +1,222 @@
+/* alice: C++ command shell library
+ * Copyright (C) 2017-2018  EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+  \file interpolation.hpp
+  \brief Substitution of variables in command arguments
+
+  \author Mathias Soeken
+*/
+
+#pragma once
+
+#include <cctype>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace alice
+{
+
+namespace detail
+{
+
+/* true, if text may refer to variables (lines without `$` take this cheap test only) */
+inline bool has_variables( std::string_view text )
+{
+  return !text.empty() && std::memchr( text.data(), '$', text.size() ) != nullptr;
+}
+
+/* Argument with references to variables, parsed once and evaluated many times
+
+   Variables are referenced as `$name` or `${name}`, where names consist of
+   letters, digits, and underscores and do not start with a digit.  `$$` is a
+   literal `$`, and a `$` that is not followed by a name (e.g., `$1` in alias
+   expansions or `$` in regular expressions) is kept as it is.  Undefined
+   variables are replaced by the empty string, or, for shell commands, kept as
+   `${name}`, such that they refer to environment variables of the shell.
+*/
+class interpolation
+{
+public:
+  explicit interpolation( std::string_view text )
+  {
+    std::string literal;
+
+    for ( std::size_t pos = 0u; pos < text.size(); )
+    {
+      const auto dollar = text.find( '$', pos );
+      literal += text.substr( pos, dollar == std::string_view::npos ? std::string_view::npos : dollar - pos );
+      if ( dollar == std::string_view::npos )
+      {
+        break;
+      }
+
+      const auto rest = text.substr( dollar + 1u );
+      if ( !rest.empty() && rest.front() == '$' )
+      {
+        literal += '$';
+        pos = dollar + 2u;
+      }
+      else if ( const auto close = rest.find( '}' ); !rest.empty() && rest.front() == '{' && close != std::string_view::npos && is_name( rest.substr( 1u, close - 1u ) ) )
+      {
+        add( literal, rest.substr( 1u, close - 1u ) );
+        pos = dollar + close + 2u;
+      }
+      else if ( const auto length = name_length( rest ); length > 0u )
+      {
+        add( literal, rest.substr( 0u, length ) );
+        pos = dollar + 1u + length;
+      }
+      else
+      {
+        literal += '$';
+        pos = dollar + 1u;
+      }
+    }
+
+    _tail = std::move( literal );
+  }
+
+  /* number of variables in the argument */
+  inline std::size_t size() const
+  {
+    return _parts.size();
+  }
+
+  /* true, if text is a valid variable name */
+  static bool is_name( std::string_view text )
+  {
+    return !text.empty() && name_length( text ) == text.size();
+  }
+
+  void evaluate( std::unordered_map<std::string, std::string> const& variables, std::string& result, bool keep_undefined = false ) const
+  {
+    result.clear();
+    for ( const auto& part : _parts )
+    {
+      result += part.literal;
+      if ( const auto it = variables.find( part.name ); it != variables.end() )
+      {
+        result += it->second;
+      }
+      else if ( keep_undefined )
+      {
+        result += "${" + part.name + "}";
+      }
+    }
+    result += _tail;
+  }
+
+private:
+  static std::size_t name_length( std::string_view text )
+  {
+    if ( text.empty() || !( std::isalpha( static_cast<unsigned char>( text.front() ) ) || text.front() == '_' ) )
+    {
+      return 0u;
+    }
+
+    std::size_t length = 1u;
+    while ( length < text.size() && ( std::isalnum( static_cast<unsigned char>( text[length] ) ) || text[length] == '_' ) )
+    {
+      ++length;
+    }
+    return length;
+  }
+
+  void add( std::string& literal, std::string_view name )
+  {
+    _parts.push_back( {std::move( literal ), std::string( name )} );
+    literal.clear();
+  }
+
+private:
+  struct part
+  {
+    std::string literal; /* text before the variable */
+    std::string name;
+  };
+
+  std::vector<part> _parts;
+  std::string _tail;
+};
+
+/* Arguments of a command line, of which some refer to variables */
+class interpolated_arguments
+{
+public:
+  /* returns false if none of the arguments refers to a variable, references to
+     undefined variables are kept if keep_undefined is true (for shell commands) */
+  template<typename Iterator>
+  bool compile( Iterator begin, Iterator end, bool keep_undefined = false )
+  {
+    _arguments.clear();
+    _keep_undefined = keep_undefined;
+    std::size_t index = 0u;
+    for ( auto it = begin; it != end; ++it, ++index )
+    {
+      const std::string_view arg = *it;
+      if ( has_variables( arg ) )
+      {
+        if ( interpolation i( arg ); i.size() > 0u || arg.find( "$$" ) != std::string_view::npos )
+        {
+          _arguments.emplace_back( index, std::move( i ) );
+        }
+      }
+    }
+    return !_arguments.empty();
+  }
+
+  inline bool empty() const
+  {
+    return _arguments.empty();
+  }
+
+  /* copies the arguments into args and replaces the ones with variables, the
+     substituted values are stored in values */
+  template<typename Iterator>
+  void evaluate( Iterator begin, Iterator end, std::unordered_map<std::string, std::string> const& variables,
+                 std::vector<std::string>& values, std::vector<std::string_view>& args ) const
+  {
+    values.resize( _arguments.size() );
+    args.assign( begin, end );
+    for ( auto i = 0u; i < _arguments.size(); ++i )
+    {
+      _arguments[i].second.evaluate( variables, values[i], _keep_undefined );
+      args[_arguments[i].first] = values[i];
+    }
+  }
+
+private:
+  std::vector<std::pair<std::size_t, interpolation>> _arguments;
+  bool _keep_undefined{false};
+};
+
+} // namespace detail
+} // namespace alice
@@ -0,0 +1,187 @@
+/* alice: C++ command shell library
+ * Copyright (C) 2017-2018  EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+  \file jobs.hpp
+  \brief Commands that run in the background
+
+  \author Mathias Soeken
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace alice
+{
+
+class command;
+
+namespace detail
+{
+
+/* A command that runs on its own worker thread
+
+   The job owns its instance of the command, its arguments, and the buffers
+   into which the command writes.  All other members must only be read after
+   `done` is set. */
+struct job
+{
+  unsigned id;
+  std::string line; /* command line without `&` */
+  std::shared_ptr<command> cmd;
+  std::vector<std::string> args;
+
+  std::chrono::system_clock::time_point start;
+  std::chrono::system_clock::time_point finish;
+  std::ostringstream out;
+  std::ostringstream err;
+  bool result{false};
+  nlohmann::json log;
+
+  std::atomic<bool> done{false};
+  std::atomic<bool> cancelled{false};
+  std::thread thread;
+};
+
+/* true, if the tokens of a command end with the operator `&` */
+template<typename Iterator>
+bool is_job( Iterator begin, Iterator end )
+{
+  return begin != end && *( end - 1 ) == "&";
+}
+
+/* Jobs that are running or that have finished but have not been reported */
+class job_list
+{
+public:
+  job_list() = default;
+  job_list( const job_list& ) = delete;
+  job_list& operator=( const job_list& ) = delete;
+
+  ~job_list()
+  {
+    for ( auto& j : jobs )
+    {
+      j->cancelled = true;
+    }
+    for ( auto& j : jobs )
+    {
+      wait( *j ); /* jobs may have been joined by `wait` already */
+    }
+  }
+
+  /* starts fn( job ) on a new thread, sets the finish time and `done` afterwards */
+  template<typename Fn>
+  job& start( std::string line, std::shared_ptr<command> cmd, std::vector<std::string> args, Fn&& fn )
+  {
+    auto& j = *jobs.emplace_back( std::make_unique<job>() );
+    j.id = next_id++;
+    j.line = std::move( line );
+    j.cmd = std::move( cmd );
+    j.args = std::move( args );
+    j.start = std::chrono::system_clock::now();
+    j.thread = std::thread( [&j, fn]() {
+      fn( j );
+      j.finish = std::chrono::system_clock::now();
+      j.done = true;
+    } );
+    return j;
+  }
+
+  /* job with id, or nullptr */
+  job* find( unsigned id ) const
+  {
+    const auto it = std::find_if( jobs.begin(), jobs.end(), [id]( auto const& j ) { return j->id == id; } );
+    return it != jobs.end() ? it->get() : nullptr;
+  }
+
+  /* waits until job has finished */
+  void wait( job& j ) const
+  {
+    if ( j.thread.joinable() )
+    {
+      j.thread.join();
+    }
+  }
+
+  /* waits until all jobs have finished */
+  void wait_all() const
+  {
+    for ( auto& j : jobs )
+    {
+      wait( *j );
+    }
+  }
+
+  /* removes finished jobs from the list and returns them in order of their ids */
+  std::vector<std::unique_ptr<job>> take_finished()
+  {
+    std::vector<std::unique_ptr<job>> finished;
+    for ( auto& j : jobs )
+    {
+      if ( j->done )
+      {
+        wait( *j );
+        finished.push_back( std::move( j ) );
+      }
+    }
+    jobs.erase( std::remove( jobs.begin(), jobs.end(), nullptr ), jobs.end() );
+
+    /* restart numbering, if no job is left */
+    if ( jobs.empty() )
+    {
+      next_id = 1u;
+    }
+    return finished;
+  }
+
+  std::vector<std::unique_ptr<job>> const& list() const
+  {
+    return jobs;
+  }
+
+  bool empty() const
+  {
+    return jobs.empty();
+  }
+
+private:
+  std::vector<std::unique_ptr<job>> jobs;
+  unsigned next_id{1u};
+};
+
+} // namespace detail
+} // namespace alice
@@ -0,0 +1,132 @@
+/* alice: C++ command shell library
+ * Copyright (C) 2017-2018  EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+  \file line_reader.hpp
+  \brief Block-wise line reader for non-interactive input
+
+  \author Mathias Soeken
+*/
+
+#pragma once
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace alice
+{
+
+namespace detail
+{
+
+/* true, if stream is connected to a terminal */
+inline bool is_terminal( std::FILE* stream )
+{
+#ifdef _WIN32
+  return _isatty( _fileno( stream ) ) != 0;
+#else
+  return ::isatty( ::fileno( stream ) ) != 0;
+#endif
+}
+
+/* Reads lines from a stream in large blocks
+
+   Used for input that does not come from a terminal, e.g., a script that is
+   piped into the shell.  In contrast to reading line by line from
+   `std::cin`, there is one read call per block and lines are split in the
+   buffer.  The stream must not be read otherwise at the same time.
+*/
+class line_reader
+{
+public:
+  explicit line_reader( std::FILE* stream, std::size_t block_size = 1u << 16u )
+      : stream( stream ), buffer( block_size )
+  {
+  }
+
+  /* reads the next line without line terminator, returns false at the end of the stream */
+  bool read_line( std::string& line )
+  {
+    line.clear();
+
+    while ( true )
+    {
+      if ( const auto* nl = static_cast<const char*>( std::memchr( buffer.data() + pos, '\n', end - pos ) ) )
+      {
+        line.append( buffer.data() + pos, nl - buffer.data() - pos );
+        pos = nl - buffer.data() + 1u;
+        return true;
+      }
+
+      line.append( buffer.data() + pos, end - pos );
+      pos = 0u;
+      end = fill();
+
+      if ( end == 0u )
+      {
+        return !line.empty();
+      }
+    }
+  }
+
+private:
+  /* reads the next block into the buffer, returns its size (0 at the end of the stream) */
+  std::size_t fill()
+  {
+#ifdef _WIN32
+    return std::fread( buffer.data(), 1u, buffer.size(), stream );
+#else
+    /* unlike `fread`, `read` returns the data that is available, such that
+       lines are executed as soon as they arrive */
+    while ( true )
+    {
+      const auto n = ::read( ::fileno( stream ), buffer.data(), buffer.size() );
+      if ( n >= 0 || errno != EINTR )
+      {
+        return n > 0 ? static_cast<std::size_t>( n ) : 0u;
+      }
+    }
+#endif
+  }
+
+private:
+  std::FILE* stream;
+  std::vector<char> buffer;
+  std::size_t pos{0u};
+  std::size_t end{0u};
+};
+
+} // namespace detail
+} // namespace alice
@@ -64,21 +64,32 @@ public:
     obj["command"] = cmdstring;
 
     /* add time */
-    const auto start_c = std::chrono::system_clock::to_time_t( start );
-    char timestr[20];
-    std::strftime( timestr, sizeof( timestr ), "%F %T", std::localtime( &start_c ) );
-
-    obj["time"] = timestr;
+    obj["time"] = format_time( start );
 
     array.push_back( obj );
   }
 
+  /* log entry of a command that has run in the background, with finish time */
+  void log( const nlohmann::json& cmdlog, const std::string& cmdstring, const std::chrono::system_clock::time_point& start, const std::chrono::system_clock::time_point& finish )
+  {
+    log( cmdlog, cmdstring, start );
+    array.back()["finish"] = format_time( finish );
+  }
+
   void stop()
   {
     std::ofstream os( _filename.c_str(), std::ofstream::out );
     os << array;
   }
 
+  static std::string format_time( const std::chrono::system_clock::time_point& time )
+  {
+    const auto time_c = std::chrono::system_clock::to_time_t( time );
+    char timestr[20];
+    std::strftime( timestr, sizeof( timestr ), "%F %T", std::localtime( &time_c ) );
+    return timestr;
+  }
+
 private:
   std::string _filename;
   nlohmann::json array = nlohmann::json::array();
@@ -0,0 +1,123 @@
+/* alice: C++ command shell library
+ * Copyright (C) 2017-2018  EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+  \file lru_cache.hpp
+  \brief Bounded cache with least-recently-used eviction
+
+  \author Mathias Soeken
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace alice
+{
+
+namespace detail
+{
+
+/* Cache from strings to values that evicts the least recently used entry
+
+   Lookups are counted as hits or misses.  The counters are kept when the cache
+   is cleared.
+*/
+template<typename Value>
+class lru_cache
+{
+public:
+  explicit lru_cache( std::size_t capacity = 1024u )
+      : _capacity( capacity )
+  {
+  }
+
+  /* returns nullptr if key is not in the cache */
+  const Value* find( std::string_view key )
+  {
+    const auto it = _index.find( key );
+    if ( it == _index.end() )
+    {
+      ++_misses;
+      return nullptr;
+    }
+
+    ++_hits;
+    _entries.splice( _entries.begin(), _entries, it->second );
+    return &it->second->second;
+  }
+
+  void insert( std::string key, Value value )
+  {
+    if ( _capacity == 0u )
+    {
+      return;
+    }
+
+    if ( const auto it = _index.find( key ); it != _index.end() )
+    {
+      it->second->second = std::move( value );
+      _entries.splice( _entries.begin(), _entries, it->second );
+      return;
+    }
+
+    if ( _entries.size() == _capacity )
+    {
+      _index.erase( _entries.back().first );
+      _entries.pop_back();
+    }
+
+    _entries.emplace_front( std::move( key ), std::move( value ) );
+    _index.emplace( _entries.front().first, _entries.begin() );
+  }
+
+  void clear()
+  {
+    _index.clear();
+    _entries.clear();
+  }
+
+  inline std::size_t size() const { return _entries.size(); }
+  inline std::size_t capacity() const { return _capacity; }
+  inline uint64_t hits() const { return _hits; }
+  inline uint64_t misses() const { return _misses; }
+
+private:
+  using entry_list = std::list<std::pair<std::string, Value>>;
+
+  std::size_t _capacity;
+  entry_list _entries;                                                       /* most recently used first */
+  std::unordered_map<std::string_view, typename entry_list::iterator> _index; /* keys are views into _entries */
+  uint64_t _hits{0u};
+  uint64_t _misses{0u};
+};
+
+} // namespace detail
+} // namespace alice
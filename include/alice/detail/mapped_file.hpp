@@ -0,0 +1,157 @@
+/* alice: C++ command shell library
+ * Copyright (C) 2017-2018  EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+  \file mapped_file.hpp
+  \brief Read-only memory mapped files
+
+  \author Mathias Soeken
+*/
+
+#pragma once
+
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace alice
+{
+
+namespace detail
+{
+
+/* Maps a file into memory for reading
+
+   In Windows the file contents are read into a string instead.
+*/
+class mapped_file
+{
+public:
+  explicit mapped_file( const std::string& filename )
+  {
+#ifdef _WIN32
+    std::ifstream in( filename.c_str(), std::ifstream::in | std::ifstream::binary );
+    if ( in.good() )
+    {
+      std::stringstream buffer;
+      buffer << in.rdbuf();
+      _buffer = buffer.str();
+      _data = _buffer.data();
+      _size = _buffer.size();
+      _open = true;
+    }
+#else
+    const auto fd = ::open( filename.c_str(), O_RDONLY );
+    if ( fd == -1 )
+    {
+      return;
+    }
+
+    struct stat st;
+    if ( ::fstat( fd, &st ) == 0 && S_ISREG( st.st_mode ) )
+    {
+      _open = true;
+      _size = static_cast<std::size_t>( st.st_size );
+
+      if ( _size > 0u )
+      {
+        auto* addr = ::mmap( nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( addr == MAP_FAILED )
+        {
+          _open = false;
+          _size = 0u;
+        }
+        else
+        {
+          ::madvise( addr, _size, MADV_SEQUENTIAL );
+          _data = static_cast<const char*>( addr );
+        }
+      }
+    }
+    ::close( fd );
+#endif
+  }
+
+  mapped_file( const mapped_file& ) = delete;
+  mapped_file& operator=( const mapped_file& ) = delete;
+
+  ~mapped_file()
+  {
+#ifndef _WIN32
+    if ( _data )
+    {
+      ::munmap( const_cast<char*>( _data ), _size );
+    }
+#endif
+  }
+
+  inline bool is_open() const
+  {
+    return _open;
+  }
+
+  inline std::string_view contents() const
+  {
+    return {_data, _size};
+  }
+
+private:
+  bool _open{false};
+  const char* _data{nullptr};
+  std::size_t _size{0u};
+#ifdef _WIN32
+  std::string _buffer;
+#endif
+};
+
+/* calls fn for each line (without line terminator) in text */
+template<typename Fn>
+void for_each_line( std::string_view text, Fn&& fn )
+{
+  const auto* pos = text.data();
+  const auto* end = text.data() + text.size();
+
+  while ( pos < end )
+  {
+    const auto* nl = static_cast<const char*>( std::memchr( pos, '\n', end - pos ) );
+    const auto* line_end = nl ? nl : end;
+
+    fn( std::string_view( pos, line_end - pos ) );
+    pos = line_end + 1;
+  }
+}
+
+} // namespace detail
+} // namespace alice
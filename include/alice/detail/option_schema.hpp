@@ -0,0 +1,362 @@
+/* alice: C++ command shell library
+ * Copyright (C) 2017-2018  EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+  \file option_schema.hpp
+  \brief Precompiled option schema for fast argument parsing
+
+  \author Mathias Soeken
+*/
+
+#pragma once
+
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <CLI11.hpp>
+
+#include "utils.hpp"
+
+namespace alice
+{
+
+namespace detail
+{
+
+/* access to protected members of CLI11 classes that have no accessors */
+struct cli11_app_access : CLI::App
+{
+  static const std::vector<CLI::Option_p>& options( const CLI::App& app ) { return app.*( &cli11_app_access::options_ ); }
+  static bool has_callback( const CLI::App& app ) { return static_cast<bool>( app.*( &cli11_app_access::callback_ ) ); }
+};
+
+struct cli11_option_access : CLI::Option
+{
+  static bool has_envname( const CLI::Option& opt ) { return !( opt.*( &cli11_option_access::envname_ ) ).empty(); }
+  static bool has_requires( const CLI::Option& opt ) { return !( opt.*( &cli11_option_access::requires_ ) ).empty(); }
+  static bool has_excludes( const CLI::Option& opt ) { return !( opt.*( &cli11_option_access::excludes_ ) ).empty(); }
+};
+
+/* Flattened view on the options of a CLI11 app
+
+   The schema is built once from the options of an app and maps option names
+   directly to options.  Its parser handles the common command lines (flags,
+   options with a fixed number of values, and positional arguments) and binds
+   values by calling the option callbacks, without building the reversed
+   argument vector and without exceptions.
+
+   If the command line uses anything else, or if it is erroneous, `parse`
+   returns false and the caller must reset the app and parse the arguments with
+   CLI11.  This way, CLI11 remains responsible for help output and for all
+   error messages.
+*/
+class option_schema
+{
+public:
+  /* true, if the schema has been built for the current options of app */
+  bool is_built_for( const CLI::App& app ) const
+  {
+    return _app == &app && _num_options == cli11_app_access::options( app ).size();
+  }
+
+  void build( const CLI::App& app )
+  {
+    const auto& options = cli11_app_access::options( app );
+
+    _app = &app;
+    _num_options = options.size();
+    _options.clear();
+    _positionals.clear();
+    _long_names.clear();
+    _short_index.fill( -1 );
+    _help = app.get_help_ptr();
+
+    _supported = app.get_subcommands( false ).empty() && app.get_config_ptr() == nullptr &&
+                 !app.get_prefix_command() && !app.get_allow_extras() && !cli11_app_access::has_callback( app );
+
+    for ( const auto& opt : options )
+    {
+      if ( opt->get_ignore_case() || cli11_option_access::has_envname( *opt ) ||
+           cli11_option_access::has_requires( *opt ) || cli11_option_access::has_excludes( *opt ) )
+      {
+        _supported = false;
+      }
+
+      const auto index = static_cast<int16_t>( _options.size() );
+      _options.push_back( opt.get() );
+
+      for ( auto name : split( opt->get_name(), "," ) )
+      {
+        trim( name );
+        if ( name.size() > 2u && name[0] == '-' && name[1] == '-' )
+        {
+          _long_names.emplace_back( name.substr( 2u ), index );
+        }
+        else if ( name.size() == 2u && name[0] == '-' )
+        {
+          _short_index[static_cast<unsigned char>( name[1] )] = index;
+        }
+        else if ( !name.empty() )
+        {
+          _positionals.push_back( opt.get() );
+        }
+      }
+    }
+  }
+
+  /* finds an option by name, names without dashes refer to short options if
+     they consist of one character (or to a long option with that name, if
+     there is no such short option), and to long options otherwise */
+  const CLI::Option* find( std::string_view name ) const
+  {
+    if ( name.empty() )
+    {
+      return nullptr;
+    }
+    else if ( name.size() > 2u && name[0] == '-' && name[1] == '-' )
+    {
+      return find_long( name.substr( 2u ) );
+    }
+    else if ( name.size() == 2u && name[0] == '-' )
+    {
+      return find_short( name[1] );
+    }
+    else if ( name[0] == '-' )
+    {
+      return nullptr;
+    }
+    else if ( name.size() == 1u )
+    {
+      const auto* opt = find_short( name[0] );
+      return opt ? opt : find_long( name );
+    }
+    else
+    {
+      return find_long( name );
+    }
+  }
+
+  /* parses arguments (without the command name) into the options of the app
+     the schema has been built for, returns false if CLI11 must be used */
+  template<typename Iterator>
+  bool parse( Iterator begin, Iterator end )
+  {
+    if ( !_supported )
+    {
+      return false;
+    }
+
+    std::string buffer;
+
+    for ( auto it = begin; it != end; )
+    {
+      const auto arg = unquote_argument( *it++, buffer );
+
+      /* long option */
+      if ( arg.size() > 2u && arg[0] == '-' && arg[1] == '-' && valid_first_char( arg[2] ) )
+      {
+        const auto eq = arg.find( '=' );
+        auto* opt = find_long( arg.substr( 2u, eq == std::string_view::npos ? std::string_view::npos : eq - 2u ) );
+        if ( !opt )
+        {
+          return false;
+        }
+
+        const auto value = eq == std::string_view::npos ? std::string_view() : arg.substr( eq + 1u );
+        const auto expected = opt->get_expected();
+
+        if ( !value.empty() )
+        {
+          if ( expected != 1 )
+          {
+            return false;
+          }
+          opt->add_result( std::string( value ) );
+        }
+        else if ( expected == 0 )
+        {
+          opt->add_result( std::string() );
+        }
+        else if ( !take_values( opt, expected, it, end ) )
+        {
+          return false;
+        }
+      }
+      /* short option or group of short flags */
+      else if ( arg.size() > 1u && arg[0] == '-' && valid_first_char( arg[1] ) )
+      {
+        for ( auto pos = 1u;; ++pos )
+        {
+          auto* opt = valid_first_char( arg[pos] ) ? find_short( arg[pos] ) : nullptr;
+          if ( !opt )
+          {
+            return false;
+          }
+
+          const auto rest = arg.substr( pos + 1u );
+          auto expected = opt->get_expected();
+
+          if ( expected == 0 )
+          {
+            opt->add_result( std::string() );
+            if ( rest.empty() )
+            {
+              break;
+            }
+            continue;
+          }
+
+          if ( expected > 0 && !rest.empty() )
+          {
+            opt->add_result( std::string( rest ) );
+            --expected;
+          }
+
+          if ( !take_values( opt, expected, it, end ) )
+          {
+            return false;
+          }
+          break;
+        }
+      }
+      /* positional argument, a single "--" is not handled */
+      else if ( arg == "--" || !add_positional( arg ) )
+      {
+        return false;
+      }
+    }
+
+    if ( _help && _help->count() )
+    {
+      return false;
+    }
+
+    for ( auto* opt : _options )
+    {
+      if ( opt->get_required() && opt->count() == 0u )
+      {
+        return false;
+      }
+      if ( opt->get_expected() < 0 && opt->count() > 0u && opt->count() < static_cast<std::size_t>( -opt->get_expected() ) )
+      {
+        return false;
+      }
+    }
+
+    for ( auto* opt : _options )
+    {
+      if ( opt->count() > 0u )
+      {
+        try
+        {
+          opt->run_callback();
+        }
+        catch ( const CLI::Error& )
+        {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+private:
+  static bool valid_first_char( char c )
+  {
+    return std::isalpha( static_cast<unsigned char>( c ) ) || c == '_';
+  }
+
+  CLI::Option* find_long( std::string_view name ) const
+  {
+    for ( const auto& p : _long_names )
+    {
+      if ( p.first == name )
+      {
+        return _options[p.second];
+      }
+    }
+    return nullptr;
+  }
+
+  CLI::Option* find_short( char name ) const
+  {
+    const auto index = _short_index[static_cast<unsigned char>( name )];
+    return index >= 0 ? _options[index] : nullptr;
+  }
+
+  /* values for an option with a fixed number of values, the unlimited case is left to CLI11 */
+  template<typename Iterator>
+  bool take_values( CLI::Option* opt, int expected, Iterator& it, Iterator end )
+  {
+    if ( expected < 0 )
+    {
+      return false;
+    }
+
+    std::string buffer;
+    for ( ; expected > 0; --expected )
+    {
+      if ( it == end )
+      {
+        return false;
+      }
+      opt->add_result( std::string( unquote_argument( *it++, buffer ) ) );
+    }
+    return true;
+  }
+
+  bool add_positional( std::string_view arg )
+  {
+    for ( auto* opt : _positionals )
+    {
+      if ( opt->get_expected() < 0 || static_cast<int>( opt->count() ) < opt->get_expected() )
+      {
+        opt->add_result( std::string( arg ) );
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  const CLI::App* _app{nullptr};
+  std::size_t _num_options{0u};
+  bool _supported{false};
+
+  std::vector<CLI::Option*> _options;
+  std::vector<CLI::Option*> _positionals;
+  std::vector<std::pair<std::string, int16_t>> _long_names;
+  std::array<int16_t, 256> _short_index;
+  const CLI::Option* _help{nullptr};
+};
+
+} // namespace detail
+} // namespace alice
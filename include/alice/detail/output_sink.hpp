@@ -0,0 +1,228 @@
+/* alice: C++ command shell library
+ * Copyright (C) 2017-2018  EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+  \file output_sink.hpp
+  \brief Buffered output streams of the environment
+
+  \author Mathias Soeken
+*/
+
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+#include <vector>
+
+#include "line_reader.hpp"
+
+namespace alice
+{
+
+/*! \brief Controls when buffered output is written
+
+  The output of commands is collected in a buffer of the environment and
+  written to the output stream according to this policy.
+*/
+enum class flush_policy
+{
+  /*! ``line`` if the output stream is a terminal, ``command`` otherwise (default) */
+  automatic,
+  /*! after each command, and when the buffer is full */
+  command,
+  /*! only when the buffer is full, and when the shell waits for input or exits */
+  size,
+  /*! after each line (output is not buffered by the environment) */
+  line
+};
+
+namespace detail
+{
+
+/* Stream buffer that collects output before writing it to a target stream
+
+   With policies `command` and `size`, output is collected in a fixed-size
+   buffer and written in one piece, and explicit flushes (e.g., by
+   `std::endl`) are ignored.  With policy `line`, output is passed on to the
+   target stream directly.  A sink can be tied to another one, which is then
+   flushed before anything is written into the sink, such that the order of
+   output and error messages is kept.
+*/
+class output_sink : public std::streambuf
+{
+public:
+  static constexpr std::size_t capacity = 1u << 16u;
+
+  explicit output_sink( std::ostream* target, flush_policy policy = flush_policy::automatic )
+      : _target( target ), _policy( policy ), _buffer( capacity )
+  {
+    update();
+  }
+
+  output_sink( const output_sink& ) = delete;
+  output_sink& operator=( const output_sink& ) = delete;
+
+  ~output_sink()
+  {
+    flush();
+  }
+
+  inline std::ostream* target() const
+  {
+    return _target;
+  }
+
+  /* changes the target stream, buffered output is written to the previous one */
+  void set_target( std::ostream* target )
+  {
+    flush();
+    _target = target;
+    update();
+  }
+
+  void set_policy( flush_policy policy )
+  {
+    flush();
+    _policy = policy;
+    update();
+  }
+
+  void tie( output_sink* other )
+  {
+    _tie = other;
+  }
+
+  /* writes buffered output to the target stream and flushes it */
+  void flush()
+  {
+    if ( pptr() != pbase() )
+    {
+      _target->write( pbase(), pptr() - pbase() );
+      setp( _buffer.data(), _buffer.data() + _buffer.size() );
+      _pending = true;
+    }
+
+    if ( _pending )
+    {
+      _target->flush();
+      _pending = false;
+    }
+  }
+
+  /* called after each command */
+  void command_finished()
+  {
+    if ( _effective == flush_policy::command )
+    {
+      flush();
+    }
+  }
+
+protected:
+  int_type overflow( int_type c ) override
+  {
+    if ( traits_type::eq_int_type( c, traits_type::eof() ) )
+    {
+      return traits_type::not_eof( c );
+    }
+
+    const auto ch = traits_type::to_char_type( c );
+    return xsputn( &ch, 1 ) == 1 ? c : traits_type::eof();
+  }
+
+  std::streamsize xsputn( const char* s, std::streamsize n ) override
+  {
+    if ( _tie )
+    {
+      _tie->flush();
+    }
+
+    if ( _effective == flush_policy::line )
+    {
+      _target->write( s, n );
+      return n;
+    }
+
+    if ( n > epptr() - pptr() )
+    {
+      flush();
+
+      /* large blocks are not copied into the buffer */
+      if ( static_cast<std::size_t>( n ) >= _buffer.size() )
+      {
+        _target->write( s, n );
+        _pending = true;
+        return n;
+      }
+    }
+
+    std::memcpy( pptr(), s, static_cast<std::size_t>( n ) );
+    pbump( static_cast<int>( n ) );
+    return n;
+  }
+
+  int sync() override
+  {
+    if ( _effective == flush_policy::line )
+    {
+      _target->flush();
+    }
+    return 0;
+  }
+
+private:
+  void update()
+  {
+    _effective = _policy;
+    if ( _policy == flush_policy::automatic )
+    {
+      const auto terminal = ( _target == &std::cout && is_terminal( stdout ) ) || ( _target == &std::cerr && is_terminal( stderr ) );
+      _effective = terminal ? flush_policy::line : flush_policy::command;
+    }
+
+    if ( _effective == flush_policy::line )
+    {
+      setp( nullptr, nullptr );
+    }
+    else
+    {
+      setp( _buffer.data(), _buffer.data() + _buffer.size() );
+    }
+  }
+
+private:
+  std::ostream* _target;
+  flush_policy _policy;
+  flush_policy _effective{flush_policy::command};
+  std::vector<char> _buffer;
+  output_sink* _tie{nullptr};
+  bool _pending{false}; /* target stream has not been flushed since the last write */
+};
+
+} // namespace detail
+} // namespace alice
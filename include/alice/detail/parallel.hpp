@@ -0,0 +1,162 @@
+/* alice: C++ command shell library
+ * Copyright (C) 2017-2018  EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+  \file parallel.hpp
+  \brief Helpers to run commands on worker threads
+
+  \author Mathias Soeken
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace alice
+{
+
+namespace detail
+{
+
+/* State of the calling thread that overrides the environment
+
+   Worker threads redirect the output of commands into private buffers, and
+   can have a private current index for one store, such that several threads
+   can work on different elements of the same store.  Commands that run in
+   the background can be cancelled through a flag.
+*/
+struct thread_context
+{
+  bool worker{false};
+  std::ostream* out{nullptr};
+  std::ostream* err{nullptr};
+  const void* view_store{nullptr};
+  int view_index{-1};
+  const std::atomic<bool>* cancelled{nullptr};
+};
+
+inline thread_context& this_thread_context()
+{
+  thread_local thread_context context;
+  return context;
+}
+
+/* sets a thread context for the lifetime of the guard */
+class thread_context_guard
+{
+public:
+  explicit thread_context_guard( thread_context const& context )
+      : saved( this_thread_context() )
+  {
+    this_thread_context() = context;
+  }
+
+  thread_context_guard( const thread_context_guard& ) = delete;
+  thread_context_guard& operator=( const thread_context_guard& ) = delete;
+
+  ~thread_context_guard()
+  {
+    this_thread_context() = saved;
+  }
+
+private:
+  thread_context saved;
+};
+
+/* number of worker threads for a requested number of jobs (0 means all cores) */
+inline unsigned num_workers( unsigned jobs, std::size_t num_tasks )
+{
+  if ( jobs == 0u )
+  {
+    jobs = std::max( 1u, std::thread::hardware_concurrency() );
+  }
+  return static_cast<unsigned>( std::min<std::size_t>( jobs, num_tasks ) );
+}
+
+/* calls fn( task, worker ) for each task in [0, num_tasks) on num_workers
+   threads, tasks are distributed dynamically, and the first exception that is
+   thrown by fn is rethrown in the calling thread */
+template<typename Fn>
+void parallel_for( std::size_t num_tasks, unsigned num_workers, Fn&& fn )
+{
+  if ( num_workers <= 1u )
+  {
+    for ( std::size_t task = 0u; task < num_tasks; ++task )
+    {
+      fn( task, 0u );
+    }
+    return;
+  }
+
+  std::atomic<std::size_t> next{0u};
+  std::exception_ptr error;
+  std::atomic_flag has_error = ATOMIC_FLAG_INIT;
+
+  const auto work = [&]( unsigned worker ) {
+    try
+    {
+      for ( auto task = next++; task < num_tasks; task = next++ )
+      {
+        fn( task, worker );
+      }
+    }
+    catch ( ... )
+    {
+      if ( !has_error.test_and_set() )
+      {
+        error = std::current_exception();
+      }
+      next = num_tasks;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve( num_workers - 1u );
+  for ( auto worker = 1u; worker < num_workers; ++worker )
+  {
+    threads.emplace_back( work, worker );
+  }
+  work( 0u );
+
+  for ( auto& t : threads )
+  {
+    t.join();
+  }
+
+  if ( error )
+  {
+    std::rethrow_exception( error );
+  }
+}
+
+} // namespace detail
+} // namespace alice
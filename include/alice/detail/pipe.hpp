@@ -0,0 +1,123 @@
+/* alice: C++ command shell library
+ * Copyright (C) 2017-2018  EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+  \file pipe.hpp
+  \brief In-memory pipes between commands
+
+  \author Mathias Soeken
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <streambuf>
+#include <string_view>
+
+namespace alice
+{
+
+namespace detail
+{
+
+/* Stream buffer that connects a writing and a reading command
+
+   Written data is appended to a list of fixed-size chunks, such that growing
+   the buffer never copies data that has been written before.  Reading takes
+   the chunks in order and releases each chunk as soon as it has been read
+   completely, such that data that has been passed on does not occupy memory
+   anymore.  Reading and writing may alternate, but not run concurrently.
+*/
+class pipe_buffer : public std::streambuf
+{
+public:
+  static constexpr std::size_t chunk_size = 1u << 16u;
+
+  pipe_buffer() = default;
+  pipe_buffer( const pipe_buffer& ) = delete;
+  pipe_buffer& operator=( const pipe_buffer& ) = delete;
+
+protected:
+  int_type overflow( int_type c ) override
+  {
+    if ( traits_type::eq_int_type( c, traits_type::eof() ) )
+    {
+      return traits_type::not_eof( c );
+    }
+
+    auto* chunk = chunks.emplace_back( std::make_unique<char[]>( chunk_size ) ).get();
+    setp( chunk, chunk + chunk_size );
+    *pptr() = traits_type::to_char_type( c );
+    pbump( 1 );
+    return c;
+  }
+
+  int_type underflow() override
+  {
+    while ( !chunks.empty() )
+    {
+      auto* begin = chunks.front().get();
+      auto* end = chunks.size() == 1u ? pptr() : begin + chunk_size;
+
+      /* continue in the same chunk, if it has been extended in the meantime */
+      auto* pos = eback() == begin ? gptr() : begin;
+
+      if ( pos < end )
+      {
+        setg( begin, pos, end );
+        return traits_type::to_int_type( *pos );
+      }
+
+      /* the chunk that is written into is kept */
+      if ( chunks.size() == 1u )
+      {
+        break;
+      }
+
+      chunks.pop_front();
+      setg( nullptr, nullptr, nullptr );
+    }
+
+    return traits_type::eof();
+  }
+
+private:
+  std::deque<std::unique_ptr<char[]>> chunks;
+};
+
+/* true, if the tokens of a command contain the pipe operator `|` (commands
+   without `|` take the memchr test only) */
+template<typename Iterator>
+bool has_pipe( std::string_view text, Iterator begin, Iterator end )
+{
+  return std::memchr( text.data(), '|', text.size() ) && std::find( begin, end, "|" ) != end;
+}
+
+} // namespace detail
+} // namespace alice
@@ -0,0 +1,467 @@
+/* alice: C++ command shell library
+ * Copyright (C) 2017-2018  EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+  \file script.hpp
+  \brief Data structures for compiled scripts
+
+  \author Mathias Soeken
+*/
+
+#pragma once
+
+#ifndef _WIN32
+#include <glob.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "alias_matcher.hpp"
+#include "interpolation.hpp"
+#include "utils.hpp"
+
+namespace alice
+{
+
+class command;
+
+namespace detail
+{
+
+/* Modification time and size of a file that a script has been compiled from */
+struct file_stamp
+{
+  std::string path;
+  std::filesystem::file_time_type mtime;
+  std::uintmax_t size;
+
+  /* stamp of a file, path is empty if the file does not exist */
+  static file_stamp of( const std::string& filename )
+  {
+    std::error_code ec;
+    auto path = std::filesystem::canonical( filename, ec );
+    if ( ec )
+    {
+      return {};
+    }
+
+    const auto mtime = std::filesystem::last_write_time( path, ec );
+    const auto size = ec ? 0u : std::filesystem::file_size( path, ec );
+    return ec ? file_stamp{} : file_stamp{path.string(), mtime, size};
+  }
+
+  bool operator==( file_stamp const& other ) const
+  {
+    return path == other.path && mtime == other.mtime && size == other.size;
+  }
+};
+
+/* Position of a line in a script file */
+struct script_location
+{
+  std::shared_ptr<const std::string> filename;
+  unsigned line;
+};
+
+/* A resolved operation of a compiled script
+
+   Aliases have been expanded, the line has been split into commands, and the
+   command has been looked up.  For shell escapes, `cmd` is `nullptr` and
+   `args` contains the shell command as single element.  All strings are views
+   into memory owned by the script.  Arguments that refer to variables are
+   substituted when the operation is executed; if the command name refers to
+   a variable, `cmd` is `nullptr` and the command is looked up then.  Lines
+   that match an alias that the script itself defines are expanded when the
+   operation is executed (`expand` is true), and their command is looked up
+   then, since the alias may not be defined yet.  For commands that are
+   connected with `|`, `cmd` is `nullptr` and `args` contains all commands
+   including the operators.  For commands that run in the background, `cmd`
+   is `nullptr` and `args` does not contain the `&`.
+
+   An `include` operation has the name of a script file as argument.  The
+   operations of the file follow up to `jump`, if the file existed when the
+   script has been compiled; if the file has changed since or did not exist
+   (`jump` is 0), it is compiled and executed when the operation is reached.
+
+   Blocks are compiled into jumps.  A `loop` operation has the loop variable
+   and the items as arguments, and `jump` is the index of its `next`
+   operation, which in turn jumps back to the loop.  A `branch` operation has
+   the condition as arguments and jumps to `jump` if it does not hold.  `jump`
+   operations jump unconditionally.  A `parallel` operation runs all
+   operations up to `jump` concurrently; it has the number of jobs as optional
+   argument.
+*/
+struct script_operation
+{
+  enum class kind
+  {
+    command,
+    shell,
+    pipe,
+    job,
+    include,
+    loop,
+    next,
+    branch,
+    jump,
+    parallel
+  };
+
+  kind type;
+  alice::command* cmd;
+  std::vector<std::string_view> args; /* including command name */
+  std::string_view text;              /* command text after alias expansion (for logging) */
+  script_location location;
+  std::string_view source;            /* source lines since the previous operation, if operation is the first one of a line (for echo) */
+  bool chained;                       /* skipped if previous operation in the same line failed */
+  interpolated_arguments variables;   /* arguments that refer to variables */
+  std::size_t jump{0u};               /* target of control flow operations */
+  bool expand{false};                 /* whether aliases are expanded when the operation is executed */
+};
+
+/* Block that is open while a script is compiled */
+struct script_block
+{
+  enum class kind
+  {
+    loop,
+    branch,
+    alternative,
+    repetition,
+    parallel
+  };
+
+  kind type;
+  std::size_t operation; /* index of the operation that opened the block */
+};
+
+/* A script that has been compiled before execution */
+struct script
+{
+  std::vector<script_operation> operations;
+  std::vector<std::string> errors;
+
+  std::vector<file_stamp> sources;  /* stamps of script files, when they were compiled */
+  std::deque<std::string> buffers;  /* contents of script files and lines that result from alias expansion */
+  std::vector<script_block> blocks; /* open blocks (only during compilation) */
+  alias_matcher aliases;            /* aliases that the script and its included files define (only during compilation) */
+  bool unknown_aliases{false};      /* whether the script may define aliases that are not in `aliases` */
+
+  /* true, if none of the script files has changed since compilation */
+  bool up_to_date() const
+  {
+    for ( const auto& stamp : sources )
+    {
+      if ( !( file_stamp::of( stamp.path ) == stamp ) )
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /* true, if filename has been compiled into the script and has not changed since */
+  bool compiled_from( const std::string& filename ) const
+  {
+    return std::find( sources.begin(), sources.end(), file_stamp::of( filename ) ) != sources.end();
+  }
+
+  /* keeps a copy of str alive as long as the script */
+  std::string_view store( std::string str )
+  {
+    return buffers.emplace_back( std::move( str ) );
+  }
+
+  void add_error( script_location const& location, std::string const& message )
+  {
+    errors.push_back( *location.filename + ":" + std::to_string( location.line ) + ": " + message );
+  }
+};
+
+/* position of the first character in line from pos on, that is outside of
+   quotes and for which match returns true, or npos */
+template<typename Fn>
+std::size_t find_unquoted( std::string_view line, std::size_t pos, Fn&& match )
+{
+  auto quoted = false;
+  for ( auto i = pos; i < line.size(); ++i )
+  {
+    if ( line[i] == '"' )
+    {
+      quoted = !quoted;
+    }
+    else if ( quoted && line[i] == '\\' )
+    {
+      ++i;
+    }
+    else if ( !quoted && match( i ) )
+    {
+      return i;
+    }
+  }
+  return std::string_view::npos;
+}
+
+/* position of a block brace (`{` or `}`) in line from pos on, or npos
+
+   Braces only delimit blocks if they are separate words outside of quotes,
+   such that braces in arguments or in `${name}` are not affected. */
+inline std::size_t find_brace( std::string_view line, char brace, std::size_t pos = 0u )
+{
+  const auto is_separator = [&]( std::size_t i ) {
+    return i >= line.size() || std::isspace( static_cast<unsigned char>( line[i] ) ) || line[i] == ';';
+  };
+
+  return find_unquoted( line, pos, [&]( std::size_t i ) {
+    return line[i] == brace && ( i == 0u || is_separator( i - 1u ) ) && is_separator( i + 1u );
+  } );
+}
+
+/* end of the first statement in a line with blocks, i.e., the position of the
+   first `;` or block brace `}`, or npos */
+inline std::size_t find_statement_end( std::string_view line )
+{
+  const auto semicolon = find_unquoted( line, 0u, [&]( std::size_t i ) { return line[i] == ';'; } );
+  return std::min( semicolon, find_brace( line, '}' ) );
+}
+
+/* true, if line contains a block brace (lines without braces take the memchr test only) */
+inline bool has_block( std::string_view line )
+{
+  return ( std::memchr( line.data(), '{', line.size() ) || std::memchr( line.data(), '}', line.size() ) ) &&
+         ( find_brace( line, '{' ) != std::string_view::npos || find_brace( line, '}' ) != std::string_view::npos );
+}
+
+/* number of blocks that are opened but not closed in text */
+inline int open_blocks( std::string_view text )
+{
+  auto count = 0;
+  for ( auto pos = find_brace( text, '{' ); pos != std::string_view::npos; pos = find_brace( text, '{', pos + 1u ) )
+  {
+    ++count;
+  }
+  for ( auto pos = find_brace( text, '}' ); pos != std::string_view::npos; pos = find_brace( text, '}', pos + 1u ) )
+  {
+    --count;
+  }
+  return count;
+}
+
+/* Items of a for loop
+
+   An item `a..b` with integers `a` and `b` expands to all integers from `a`
+   to `b` (inclusive, also counting down), an item with a wildcard (`*`, `?`,
+   or `[`) expands to the matching paths in sorted order, and all other items
+   are taken as they are.  Ranges keep their bounds only and produce their
+   values one at a time, such that a loop over a large range does not
+   allocate all of its values. */
+class loop_items
+{
+public:
+  /* starts a loop over items, returns false if there are no values */
+  bool start( std::vector<std::string_view> const& items )
+  {
+    _items.clear();
+
+    for ( auto item : items )
+    {
+      std::string buffer;
+      item = unquote_argument( item, buffer );
+
+      if ( const auto dots = item.find( ".." ); dots != std::string_view::npos )
+      {
+        const auto* first_end = item.data() + dots;
+        const auto* last_end = item.data() + item.size();
+        long first{}, last{};
+        const auto r1 = std::from_chars( item.data(), first_end, first );
+        const auto r2 = std::from_chars( first_end + 2, last_end, last );
+
+        if ( r1.ec == std::errc() && r1.ptr == first_end && r2.ec == std::errc() && r2.ptr == last_end && dots > 0u )
+        {
+          _items.push_back( {{}, first, last, true} );
+          continue;
+        }
+      }
+
+#ifndef _WIN32
+      if ( item.find_first_of( "*?[" ) != std::string_view::npos )
+      {
+        glob_t g;
+        if ( ::glob( std::string( item ).c_str(), 0, nullptr, &g ) == 0 )
+        {
+          for ( auto i = 0u; i < g.gl_pathc; ++i )
+          {
+            _items.push_back( {g.gl_pathv[i], 0, 0, false} );
+          }
+        }
+        ::globfree( &g );
+        continue;
+      }
+#endif
+
+      _items.push_back( {std::string( item ), 0, 0, false} );
+    }
+
+    _index = 0u;
+    return load();
+  }
+
+  /* advances to the next value, returns false after the last one */
+  bool next()
+  {
+    if ( const auto& item = _items[_index]; item.range && _number != item.last )
+    {
+      _number += item.first <= item.last ? 1 : -1;
+      _value = std::to_string( _number );
+      return true;
+    }
+
+    ++_index;
+    return load();
+  }
+
+  inline std::string const& value() const
+  {
+    return _value;
+  }
+
+private:
+  /* takes the first value of the item at _index */
+  bool load()
+  {
+    if ( _index >= _items.size() )
+    {
+      return false;
+    }
+
+    if ( const auto& item = _items[_index]; item.range )
+    {
+      _number = item.first;
+      _value = std::to_string( _number );
+    }
+    else
+    {
+      _value = item.value;
+    }
+    return true;
+  }
+
+private:
+  struct item
+  {
+    std::string value;
+    long first;
+    long last;
+    bool range;
+  };
+
+  std::vector<item> _items;
+  std::size_t _index{0u};
+  long _number{0};
+  std::string _value;
+};
+
+/* true, if the condition of an `if` or `while` block has a valid form */
+inline bool is_condition( std::vector<std::string_view> const& args )
+{
+  switch ( args.size() )
+  {
+  case 1u:
+    return true;
+  case 2u:
+    return args[0] == "!";
+  case 3u:
+    return args[1] == "==" || args[1] == "!=" || args[1] == "<" || args[1] == "<=" || args[1] == ">" || args[1] == ">=";
+  default:
+    return false;
+  }
+}
+
+/* Evaluates a condition
+
+   A single value holds if it is neither empty nor `0` nor `false`, and `!`
+   negates it.  Comparisons compare numerically if both sides are numbers and
+   lexicographically otherwise. */
+inline bool evaluate_condition( std::vector<std::string_view> const& args )
+{
+  std::string lbuffer, rbuffer;
+
+  if ( args.size() < 3u )
+  {
+    const auto value = unquote_argument( args.back(), lbuffer );
+    const auto holds = !value.empty() && value != "0" && value != "false";
+    return args.size() == 1u ? holds : !holds;
+  }
+
+  const auto lhs = unquote_argument( args[0], lbuffer );
+  const auto rhs = unquote_argument( args[2], rbuffer );
+  const auto op = args[1];
+
+  const auto to_number = []( std::string_view s, double& value ) {
+    const std::string str( s );
+    char* end{};
+    value = std::strtod( str.c_str(), &end );
+    return !str.empty() && end == str.c_str() + str.size();
+  };
+
+  double l{}, r{};
+  const auto c = ( to_number( lhs, l ) && to_number( rhs, r ) ) ? ( l < r ? -1 : ( l > r ? 1 : 0 ) ) : lhs.compare( rhs );
+
+  if ( op == "==" )
+  {
+    return c == 0;
+  }
+  else if ( op == "!=" )
+  {
+    return c != 0;
+  }
+  else if ( op == "<" )
+  {
+    return c < 0;
+  }
+  else if ( op == "<=" )
+  {
+    return c <= 0;
+  }
+  else if ( op == ">" )
+  {
+    return c > 0;
+  }
+  return c >= 0;
+}
+
+} // namespace detail
+} // namespace alice
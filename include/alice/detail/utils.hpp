@@ -35,9 +35,12 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstring>
 #include <locale>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include <fmt/format.h>
 
@@ -175,6 +178,162 @@ inline std::vector<std::string> split_with_quotes( const std::string& commands )
   return result;
 }
 
+inline std::string_view trim_view( std::string_view s )
+{
+  while ( !s.empty() && std::isspace( static_cast<unsigned char>( s.front() ) ) )
+  {
+    s.remove_prefix( 1u );
+  }
+  while ( !s.empty() && std::isspace( static_cast<unsigned char>( s.back() ) ) )
+  {
+    s.remove_suffix( 1u );
+  }
+  return s;
+}
+
+/* Single-pass tokenizer for command lines
+
+   Splits a line into semicolon-separated commands and each command into
+   space-separated tokens, following the same quote and escape rules as
+   `split_with_quotes`.  Tokens are views into the line that was passed to
+   `tokenize`, which must outlive them.  The internal vectors keep their
+   capacity, such that tokenizing lines with the same tokenizer does not
+   allocate memory once it has seen a line of similar size.  Empty commands
+   and empty tokens are skipped.
+*/
+class line_tokenizer
+{
+public:
+  struct command_span
+  {
+    std::string_view text;  /* trimmed command text */
+    std::size_t first;      /* index of first token */
+    std::size_t size;       /* number of tokens */
+  };
+
+  /* returns false if the line contains an unterminated quote */
+  bool tokenize( std::string_view line )
+  {
+    _commands.clear();
+    _tokens.clear();
+
+    /* most lines contain neither quotes nor separators, they are split at
+       spaces without running the state machine */
+    if ( !std::memchr( line.data(), '"', line.size() ) && !std::memchr( line.data(), ';', line.size() ) )
+    {
+      const auto* pos = line.data();
+      const auto* end = line.data() + line.size();
+      while ( pos < end )
+      {
+        const auto* sp = static_cast<const char*>( std::memchr( pos, ' ', end - pos ) );
+        const auto* token_end = sp ? sp : end;
+        add_token( std::string_view( pos, token_end - pos ) );
+        pos = token_end + 1;
+      }
+      add_command( line );
+      return true;
+    }
+
+    enum _state
+    {
+      normal,
+      quote,
+      escape
+    };
+
+    _state s = normal;
+    std::size_t token_begin = 0u, command_begin = 0u;
+
+    for ( std::size_t i = 0u; i < line.size(); ++i )
+    {
+      const auto c = line[i];
+      switch ( s )
+      {
+      case normal:
+        if ( c == '"' )
+        {
+          s = quote;
+        }
+        else if ( c == ' ' )
+        {
+          add_token( line.substr( token_begin, i - token_begin ) );
+          token_begin = i + 1u;
+        }
+        else if ( c == ';' )
+        {
+          add_token( line.substr( token_begin, i - token_begin ) );
+          add_command( line.substr( command_begin, i - command_begin ) );
+          token_begin = command_begin = i + 1u;
+        }
+        break;
+
+      case quote:
+        if ( c == '"' )
+        {
+          s = normal;
+        }
+        else if ( c == '\\' )
+        {
+          s = escape;
+        }
+        break;
+
+      case escape:
+        s = quote;
+        break;
+      }
+    }
+
+    add_token( line.substr( token_begin ) );
+    add_command( line.substr( command_begin ) );
+
+    return s == normal;
+  }
+
+  inline const std::vector<command_span>& commands() const
+  {
+    return _commands;
+  }
+
+  inline const std::vector<std::string_view>& tokens() const
+  {
+    return _tokens;
+  }
+
+  inline auto begin( command_span const& cmd ) const
+  {
+    return _tokens.begin() + cmd.first;
+  }
+
+  inline auto end( command_span const& cmd ) const
+  {
+    return _tokens.begin() + cmd.first + cmd.size;
+  }
+
+private:
+  void add_token( std::string_view token )
+  {
+    token = trim_view( token );
+    if ( !token.empty() )
+    {
+      _tokens.push_back( token );
+    }
+  }
+
+  void add_command( std::string_view text )
+  {
+    const auto first = _commands.empty() ? 0u : _commands.back().first + _commands.back().size;
+    if ( _tokens.size() > first )
+    {
+      _commands.push_back( {trim_view( text ), first, _tokens.size() - first} );
+    }
+  }
+
+private:
+  std::vector<command_span> _commands;
+  std::vector<std::string_view> _tokens;
+};
+
 // https://stackoverflow.com/a/14266139
 inline std::vector<std::string> split( const std::string& str, const std::string& sep )
 {
@@ -203,29 +362,31 @@ inline std::pair<int, std::string> execute_program( const std::string& cmd )
 {
   char buffer[128];
   std::string result;
-  int exit_status;
 
-  std::shared_ptr<FILE> pipe( popen( cmd.c_str(), "r" ), [&exit_status]( FILE* fp ) { auto status = pclose( fp ); exit_status = WEXITSTATUS( status ); } );
+  auto* pipe = popen( cmd.c_str(), "r" );
   if ( !pipe )
   {
     throw std::runtime_error( "[e] popen() failed" );
   }
-  while ( !feof( pipe.get() ) )
+  while ( !feof( pipe ) )
   {
-    if ( fgets( buffer, 128, pipe.get() ) != NULL )
+    if ( fgets( buffer, 128, pipe ) != NULL )
     {
       result += buffer;
     }
   }
-  return {exit_status, result};
+
+  /* the exit status is only known after the pipe is closed */
+  const auto status = pclose( pipe );
+  return {WEXITSTATUS( status ), result};
 }
 #endif
 
 // based on https://stackoverflow.com/questions/5612182/convert-string-with-explicit-escape-sequence-into-relative-character
-inline std::string unescape_quotes( const std::string& s )
+inline std::string unescape_quotes( std::string_view s )
 {
   std::string res;
-  std::string::const_iterator it = s.begin();
+  auto it = s.begin();
 
   while ( it != s.end() )
   {
@@ -241,6 +402,28 @@ inline std::string unescape_quotes( const std::string& s )
   return res;
 }
 
+/* removes the quotes of a quoted argument or of the value in `key="value"`,
+   returns a view into arg or into buffer */
+inline std::string_view unquote_argument( std::string_view arg, std::string& buffer )
+{
+  if ( arg.size() > 2 && arg.front() == '"' && arg.back() == '"' )
+  {
+    buffer = unescape_quotes( arg.substr( 1, arg.size() - 2 ) );
+    return buffer;
+  }
+
+  const auto c_eq = arg.find( '=' );
+  const auto c_q = arg.find( '"' );
+
+  if ( c_eq != std::string_view::npos && c_q != std::string_view::npos && c_q == c_eq + 1 && arg.back() == '"' )
+  {
+    buffer = unescape_quotes( std::string( arg.substr( 0, c_eq + 1 ) ) + std::string( arg.substr( c_q + 1, arg.size() - c_q - 2 ) ) );
+    return buffer;
+  }
+
+  return arg;
+}
+
 #ifdef _WIN32
 inline const std::string& word_exp_filename( const std::string& filename )
 {
@@ -39,17 +39,17 @@
 
 namespace alice
 {
+/* The rules are kept by a command of env, and therefore capture env as raw
+   pointer; a shared pointer would keep env and its commands alive forever. */
 template<typename S>
-command::rule has_store_element( const environment::ptr& env )
+command::lazy_rule has_store_element( const environment::ptr& env )
 {
-  auto constexpr name = store_info<S>::name;
-  return { [&]() { return env->store<S>().current_index() >= 0; }, fmt::format( "no current {} available", name ) };
+  return { [e = env.get()]() { return e->store<S>().current_index() >= 0; }, []() { return fmt::format( "no current {} available", store_info<S>::name ); } };
 }
 
 template<typename S>
-command::rule has_store_element_if_set( const command& cmd, const environment::ptr& env, const std::string& argname )
+command::lazy_rule has_store_element_if_set( const command& cmd, const environment::ptr& env, const std::string& argname )
 {
-  auto constexpr name = store_info<S>::name;
-  return { [&cmd, &env, argname]() { return !cmd.is_set( argname ) || env->store<S>().current_index() >= 0; }, fmt::format( "no current {} available", name ) };
+  return { [&cmd, e = env.get(), argname]() { return !cmd.is_set( argname ) || e->store<S>().current_index() >= 0; }, []() { return fmt::format( "no current {} available", store_info<S>::name ); } };
 }
 }
@@ -32,15 +32,169 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <fmt/format.h>
 
+#include "detail/parallel.hpp"
+
 namespace alice
 {
 
+namespace detail
+{
+
+/* versions are unique across all stores, such that equal versions imply equal store contents */
+inline uint64_t next_store_version()
+{
+  static std::atomic<uint64_t> version{0u};
+  return ++version;
+}
+
+/* A store that is locked by the calling thread */
+struct held_store_lock
+{
+  const void* store;
+  bool write;
+};
+
+inline std::vector<held_store_lock>& held_store_locks()
+{
+  thread_local std::vector<held_store_lock> locks;
+  return locks;
+}
+
+/* Locks a store for reading or writing for the lifetime of the object
+
+   A store that the calling thread has already locked is not locked again,
+   such that commands can use guards in their code for stores that the shell
+   has locked for them.  A store that is locked for reading cannot be locked
+   for writing by the same thread.  Stores of which the calling thread has a
+   private view (inside `foreach`) are locked by the owner of the view. */
+class store_lock
+{
+public:
+  store_lock( const void* store, std::shared_mutex& mutex, bool write )
+  {
+    if ( this_thread_context().view_store == store )
+    {
+      return;
+    }
+
+    const auto& held = held_store_locks();
+    if ( const auto it = std::find_if( held.begin(), held.end(), [store]( auto const& lock ) { return lock.store == store; } ); it != held.end() )
+    {
+      if ( write && !it->write )
+      {
+        throw std::logic_error( "cannot write to a store that is locked for reading" );
+      }
+      return;
+    }
+
+    if ( write )
+    {
+      mutex.lock();
+    }
+    else
+    {
+      mutex.lock_shared();
+    }
+    _mutex = &mutex;
+    _store = store;
+    _write = write;
+    held_store_locks().push_back( {store, write} );
+  }
+
+  store_lock( store_lock&& other ) noexcept
+      : _store( other._store ),
+        _mutex( std::exchange( other._mutex, nullptr ) ),
+        _write( other._write )
+  {
+  }
+
+  store_lock( const store_lock& ) = delete;
+  store_lock& operator=( const store_lock& ) = delete;
+  store_lock& operator=( store_lock&& ) = delete;
+
+  ~store_lock()
+  {
+    if ( !_mutex )
+    {
+      return;
+    }
+
+    auto& held = held_store_locks();
+    held.erase( std::find_if( held.begin(), held.end(), [this]( auto const& lock ) { return lock.store == _store; } ) );
+
+    if ( _write )
+    {
+      _mutex->unlock();
+    }
+    else
+    {
+      _mutex->unlock_shared();
+    }
+  }
+
+private:
+  const void* _store{nullptr};
+  std::shared_mutex* _mutex{nullptr};
+  bool _write{false};
+};
+
+} // namespace detail
+
+/*! \brief Scoped access to a store
+
+  Keeps the store locked as long as the guard exists, and gives access to it
+  like a pointer.  Guards are returned by ``store_container::read`` (``Store``
+  is const) and ``store_container::write``.
+*/
+template<class Store>
+class store_guard
+{
+public:
+  store_guard( Store& store, bool write )
+      : _lock( &store, store.mutex(), write ),
+        _store( store )
+  {
+  }
+
+  inline Store* operator->() const
+  {
+    return &_store;
+  }
+
+  inline Store& operator*() const
+  {
+    return _store;
+  }
+
+private:
+  detail::store_lock _lock;
+  Store& _store;
+};
+
 /*! \brief Store container
+
+  Each store has a version that changes whenever the store is accessed through
+  a non-const method.  Read-only code should therefore access the store through
+  a const reference.
+
+  Each store also has a reader-writer lock.  Commands that declare their
+  access to a store (see ``command::reads_store`` and
+  ``command::writes_store``) hold the lock while they run.  Other code that
+  may run concurrently with commands, e.g., in background jobs or from
+  several Python threads, should access the store through the guards that
+  are returned by ``read`` and ``write``.
  */
 template<class T>
 class store_container
@@ -56,22 +210,25 @@ public:
    */
   inline T& current()
   {
-    if ( _current < 0 )
+    const auto index = current_index();
+    if ( index < 0 )
     {
       throw fmt::format( "[e] no current {} available", _name );
     }
-    return _data[_current];
+    touch();
+    return _data[index];
   }
 
   /*! \brief Retrieve constant reference to current store item
    */
   inline const T& current() const
   {
-    if ( _current < 0 )
+    const auto index = current_index();
+    if ( index < 0 )
     {
       throw fmt::format( "[e] no current {} available", _name );
     }
-    return _data[_current];
+    return _data[index];
   }
 
   /*! \brief Retrieve mutable reference to current store item
@@ -98,6 +255,7 @@ public:
     {
       throw fmt::format( "[e] index {} is out of bounds", index );
     }
+    touch();
     return _data[index];
   }
 
@@ -135,10 +293,15 @@ public:
     return _data;
   }
 
-  /*! \brief Returns the current index in the store */
+  /*! \brief Returns the current index in the store
+
+    If the calling thread has a private view on the store (e.g., inside
+    ``foreach``), the index of the view is returned.
+  */
   inline int current_index() const
   {
-    return _current;
+    const auto& context = detail::this_thread_context();
+    return context.view_store == this ? context.view_index : _current;
   }
 
   /* \brief Sets the current index */
@@ -146,10 +309,64 @@ public:
   {
     if ( i < _data.size() )
     {
-      _current = i;
+      touch();
+      if ( auto& context = detail::this_thread_context(); context.view_store == this )
+      {
+        context.view_index = i;
+      }
+      else
+      {
+        _current = i;
+      }
     }
   }
 
+  /*! \brief Returns the current version of the store */
+  inline uint64_t version() const
+  {
+    return _version.load( std::memory_order_relaxed );
+  }
+
+  /*! \brief Restores a version
+
+    This is used after a command that has been declared to only read from the
+    store, since it may have accessed the store through a non-const method.
+  */
+  inline void restore_version( uint64_t version )
+  {
+    _version.store( version, std::memory_order_relaxed );
+  }
+
+  /*! \brief Locks the store for reading
+
+    The store is locked until the returned guard is destroyed.  Several
+    threads can read from the store at the same time.
+
+    .. code-block:: c++
+
+       const auto size = env->store<aig_t>().read()->size();
+  */
+  inline store_guard<const store_container<T>> read() const
+  {
+    return {*this, false};
+  }
+
+  /*! \brief Locks the store for writing
+
+    The store is locked until the returned guard is destroyed, and no other
+    thread can read from or write to it in the meantime.
+  */
+  inline store_guard<store_container<T>> write()
+  {
+    return {*this, true};
+  }
+
+  /*! \brief Returns the reader-writer lock of the store */
+  inline std::shared_mutex& mutex() const
+  {
+    return _mutex;
+  }
+
   /*! \brief Extend the store by one element and update current element
 
     The current element is set to the added store element.
@@ -157,6 +374,8 @@ public:
   template<class... Args>
   T& extend( Args&&... args )
   {
+    check_no_view();
+    touch();
     _current = _data.size();
     _data.push_back( T(std::forward<Args>( args )...) );
     return _data.back();
@@ -171,12 +390,16 @@ public:
   */
   void pop_current()
   {
-    if ( _data.empty() || _current == -1 ) return;
+    check_no_view();
+
+    const auto index = current_index();
+    if ( _data.empty() || index == -1 ) return;
 
-    _data.erase( _data.begin() + _current );
-    if ( _current == static_cast<int>( _data.size() ) )
+    touch();
+    _data.erase( _data.begin() + index );
+    if ( index == static_cast<int>( _data.size() ) )
     {
-      --_current;
+      _current = index - 1;
     }
   }
 
@@ -184,6 +407,8 @@ public:
    */
   void clear()
   {
+    check_no_view();
+    touch();
     _data.clear();
     _current = -1;
   }
@@ -201,10 +426,28 @@ public:
     }
   }
 
+private:
+  /* elements cannot be added or removed through a private view (inside
+     `foreach`), since other threads may work on the elements at the same time */
+  inline void check_no_view() const
+  {
+    if ( detail::this_thread_context().view_store == this )
+    {
+      throw std::logic_error( fmt::format( "cannot add or remove {} elements while iterating over the store", _name ) );
+    }
+  }
+
+  inline void touch()
+  {
+    _version.store( detail::next_store_version(), std::memory_order_relaxed );
+  }
+
 private:
   std::string _name;
   std::vector<T> _data;
   int _current{-1};
+  std::atomic<uint64_t> _version{detail::next_store_version()};
+  mutable std::shared_mutex _mutex;
 };
 
 }
@@ -218,6 +218,24 @@ StoreType read( const std::string& filename, const command& cmd )
   throw std::runtime_error( "[e] unimplemented function" );
 }
 
+/*! \brief Reads from a stream and returns store element
+
+  This function should be enabled by overriding the `can_read` function for the
+  same store element type and format tag.  It is called instead of the
+  function that reads from a file, if a read command is called without a
+  filename and its input comes from a pipe, e.g., ``write_aiger | read_aiger``.
+
+  \param is Input stream to read from
+  \param cmd Reference to command, e.g., to check whether custom options are set
+*/
+template<typename StoreType, typename Tag>
+StoreType read( std::istream& is, const command& cmd )
+{
+  (void)is;
+  (void)cmd;
+  throw std::runtime_error( "[e] unimplemented function" );
+}
+
 /*! \brief Controls whether a store entry can write to a specific format
 
   If this function is overriden to return true, then also the function
@@ -252,10 +270,11 @@ void write( StoreType const& element, const std::string& filename, const command
   throw std::runtime_error( "[e] unimplemented function" );
 }
 
-/*! \brief Writes store element to log file
+/*! \brief Writes store element to log file or pipe
 
   This function should be enabled by overriding the `can_write` function for the
-  same store element type and format tag.
+  same store element type and format tag.  It is used for ``--log`` and if the
+  output of a write command is passed to the next command with ``|``.
 
   \param element Store element to write
   \param os Output stream to write to
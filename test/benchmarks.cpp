@@ -0,0 +1,412 @@
+#include <catch.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <alice/alice.hpp>
+
+using namespace alice;
+
+/* benchmarks are hidden, run them with `run_tests [benchmark]` */
+
+namespace
+{
+
+constexpr std::array<std::string_view, 24> benchmark_command_names = {
+    "alias", "help", "quit", "set", "convert", "current", "print", "ps", "show", "store",
+    "read_aiger", "write_aiger", "read_bench", "write_bench", "read_blif", "write_blif",
+    "read_verilog", "write_verilog", "strash", "balance", "rewrite", "refactor", "resub", "map"};
+
+/* result of parsing a file, parsing is simulated by hashing the contents repeatedly */
+struct parsed_file
+{
+  std::size_t hash{0u};
+};
+
+struct parsed_file_tag_t;
+
+}
+
+namespace alice
+{
+
+template<>
+struct store_info<parsed_file>
+{
+  static constexpr const char* key = "parsed";
+  static constexpr const char* option = "parsed";
+  static constexpr const char* mnemonic = "p";
+  static constexpr const char* name = "parsed file";
+  static constexpr const char* name_plural = "parsed files";
+};
+
+template<>
+bool can_read<parsed_file, parsed_file_tag_t>( command& cmd )
+{
+  (void)cmd;
+  return true;
+}
+
+template<>
+parsed_file read<parsed_file, parsed_file_tag_t>( const std::string& filename, const command& cmd )
+{
+  (void)cmd;
+  std::ifstream in( filename );
+  const std::string contents( ( std::istreambuf_iterator<char>( in ) ), std::istreambuf_iterator<char>() );
+
+  parsed_file file;
+  for ( auto i = 0u; i < 200u; ++i )
+  {
+    file.hash = file.hash * 31u + std::hash<std::string>()( contents );
+  }
+  return file;
+}
+
+}
+
+TEST_CASE( "Command lookup", "[.][benchmark]" )
+{
+  constexpr auto perfect = detail::make_perfect_hash( benchmark_command_names );
+
+  std::unordered_map<std::string, std::shared_ptr<command>> map;
+  detail::command_table table;
+  table.assign( perfect );
+  for ( const auto& name : benchmark_command_names )
+  {
+    map[std::string( name )] = nullptr;
+  }
+
+  std::vector<std::string> script;
+  for ( auto i = 0u; i < 1000u; ++i )
+  {
+    script.emplace_back( benchmark_command_names[( i * 7u ) % benchmark_command_names.size()] );
+  }
+
+  BENCHMARK( "unordered_map" )
+  {
+    auto found = 0u;
+    for ( const auto& name : script )
+    {
+      found += map.find( name ) != map.end();
+    }
+    return found;
+  };
+
+  BENCHMARK( "perfect hash" )
+  {
+    auto found = 0u;
+    for ( const auto& name : script )
+    {
+      found += perfect.slot( name ) >= 0;
+    }
+    return found;
+  };
+
+  BENCHMARK( "command_table" )
+  {
+    auto found = 0u;
+    for ( const auto& name : script )
+    {
+      found += table.find( name ) == nullptr;
+    }
+    return found;
+  };
+}
+
+TEST_CASE( "Tokenize command lines", "[.][benchmark]" )
+{
+  const std::string line = "read_aiger -n --log \"file name.aig\"; strash; balance -v; write_aiger \"out; put.aig\"";
+  detail::line_tokenizer tokenizer;
+
+  BENCHMARK( "split_with_quotes" )
+  {
+    auto count = 0u;
+    for ( const auto& part : detail::split_with_quotes<';'>( line ) )
+    {
+      count += detail::split_with_quotes<' '>( part ).size();
+    }
+    return count;
+  };
+
+  BENCHMARK( "line_tokenizer" )
+  {
+    tokenizer.tokenize( line );
+    return tokenizer.tokens().size();
+  };
+}
+
+TEST_CASE( "Read script lines", "[.][benchmark]" )
+{
+  /* throughput in lines per second is 100000 divided by the reported mean */
+  constexpr auto num_lines = 100000u;
+  const std::string filename = "alice_benchmark_script.txt";
+  {
+    std::ofstream out( filename.c_str(), std::ofstream::out );
+    for ( auto i = 0u; i < num_lines; ++i )
+    {
+      out << "read_aiger -n --log file" << i << ".aig; strash; balance -v\n";
+    }
+  }
+
+  BENCHMARK( "ifstream and getline (100000 lines)" )
+  {
+    std::ifstream in( filename.c_str(), std::ifstream::in );
+    std::string line;
+    auto size = 0u;
+    while ( getline( in, line ) )
+    {
+      detail::trim( line );
+      size += line.size();
+    }
+    return size;
+  };
+
+  BENCHMARK( "mapped_file and for_each_line (100000 lines)" )
+  {
+    detail::mapped_file file( filename );
+    auto size = 0u;
+    detail::for_each_line( file.contents(), [&]( std::string_view line ) {
+      size += detail::trim_view( line ).size();
+    } );
+    return size;
+  };
+
+  std::remove( filename.c_str() );
+}
+
+TEST_CASE( "Parse command options", "[.][benchmark]" )
+{
+  bool verbose{false};
+  int number{0};
+  std::string name;
+  std::vector<std::string> files;
+
+  CLI::App app( "options" );
+  app.add_flag( "-v,--verbose", verbose, "be verbose" );
+  app.add_option( "-n,--number", number, "some number" );
+  app.add_option( "--name", name, "some name" );
+  app.add_option( "files", files, "files" );
+
+  const std::vector<std::string_view> tokens = {"opts", "-v", "-n", "5", "--name=x", "a.aig", "b.aig"};
+
+  detail::option_schema schema;
+  schema.build( app );
+
+  BENCHMARK( "CLI11 parse" )
+  {
+    app.reset();
+    std::vector<std::string> args;
+    for ( auto it = tokens.end(); it != tokens.begin() + 1; )
+    {
+      args.emplace_back( *--it );
+    }
+    app.parse( args );
+    return number;
+  };
+
+  BENCHMARK( "option schema" )
+  {
+    app.reset();
+    schema.parse( tokens.begin() + 1, tokens.end() );
+    return number;
+  };
+}
+
+namespace
+{
+
+class files_command : public command
+{
+public:
+  explicit files_command( const environment::ptr& env ) : command( env, "Command with many files" )
+  {
+    add_option( "files", files, "files" );
+  }
+
+  using command::run;
+
+protected:
+  void execute()
+  {
+    num_files = files.size();
+    files.clear();
+  }
+
+public:
+  std::size_t num_files{0u};
+
+private:
+  std::vector<std::string> files;
+};
+
+}
+
+TEST_CASE( "Pass long argument lists", "[.][benchmark]" )
+{
+  auto cmd = std::make_shared<files_command>( std::make_shared<environment>() );
+
+  std::string line = "files";
+  {
+    std::ofstream os( "/tmp/alice_benchmark_files.txt", std::ofstream::out );
+    for ( auto i = 0u; i < 20000u; ++i )
+    {
+      const auto filename = fmt::format( "/path/to/some/directory/file{:05}.aig", i );
+      line += " " + filename;
+      os << filename << "\n";
+    }
+  }
+
+  BENCHMARK( "split_with_quotes (20000 arguments)" )
+  {
+    cmd->run( detail::split_with_quotes<' '>( line ) );
+    return cmd->num_files;
+  };
+
+  BENCHMARK( "response file (20000 arguments)" )
+  {
+    cmd->run( {"files", "@/tmp/alice_benchmark_files.txt"} );
+    return cmd->num_files;
+  };
+
+  std::remove( "/tmp/alice_benchmark_files.txt" );
+}
+
+TEST_CASE( "Print many lines", "[.][benchmark]" )
+{
+  /* output into a file stream, where each flush is a system call */
+  constexpr auto num_lines = 100000u;
+  auto env = std::make_shared<environment>();
+  std::ofstream null( "/dev/null" );
+  env->reroute( null, null );
+
+  const auto print = [&]( flush_policy policy ) {
+    env->set_flush_policy( policy );
+    for ( auto i = 0u; i < num_lines; ++i )
+    {
+      env->out() << fmt::format( "{:>5}: ", i ) << "statistics" << std::endl;
+    }
+    env->flush();
+    return num_lines;
+  };
+
+  BENCHMARK( "flush after each line (100000 lines)" )
+  {
+    return print( flush_policy::line );
+  };
+
+  BENCHMARK( "flush when buffer is full (100000 lines)" )
+  {
+    return print( flush_policy::size );
+  };
+
+  BENCHMARK( "env->print, flush when buffer is full (100000 lines)" )
+  {
+    env->set_flush_policy( flush_policy::size );
+    for ( auto i = 0u; i < num_lines; ++i )
+    {
+      env->print( "{:>5}: statistics\n", i );
+    }
+    env->flush();
+    return num_lines;
+  };
+}
+
+TEST_CASE( "Lock stores", "[.][benchmark]" )
+{
+  /* overhead of locks without contention */
+  constexpr auto num_accesses = 1000000u;
+  store_container<std::string> strings( "string" ), others( "other" );
+  strings.extend() = "Hello world";
+  others.extend() = "Hi";
+
+  BENCHMARK( "without lock (1000000 accesses)" )
+  {
+    auto size = 0u;
+    for ( auto i = 0u; i < num_accesses; ++i )
+    {
+      size += std::as_const( strings ).current().size();
+    }
+    return size;
+  };
+
+  BENCHMARK( "read guard (1000000 accesses)" )
+  {
+    auto size = 0u;
+    for ( auto i = 0u; i < num_accesses; ++i )
+    {
+      size += strings.read()->current().size();
+    }
+    return size;
+  };
+
+  BENCHMARK( "write guard (1000000 accesses)" )
+  {
+    auto size = 0u;
+    for ( auto i = 0u; i < num_accesses; ++i )
+    {
+      size += strings.write()->current().size();
+    }
+    return size;
+  };
+
+  /* what the shell does before each command that reads one store and writes another */
+  std::vector<detail::store_dependency> dependencies{detail::make_store_dependency( strings ), detail::make_store_dependency( others )};
+  std::sort( dependencies.begin(), dependencies.end(), []( auto const& a, auto const& b ) { return std::less<const void*>()( a.store, b.store ); } );
+  dependencies[dependencies[0].store == &strings ? 0 : 1].reads = true;
+  dependencies[dependencies[0].store == &others ? 0 : 1].writes = true;
+
+  BENCHMARK( "lock the stores of a command (1000000 commands)" )
+  {
+    auto size = 0u;
+    for ( auto i = 0u; i < num_accesses; ++i )
+    {
+      const detail::dependency_locks locks( dependencies );
+      size += std::as_const( strings ).current().size();
+    }
+    return size;
+  };
+}
+
+TEST_CASE( "Read many files", "[.][benchmark]" )
+{
+  constexpr auto num_files = 200u;
+  std::string line = "read_parsed";
+  for ( auto i = 0u; i < num_files; ++i )
+  {
+    const auto filename = fmt::format( "/tmp/alice_bench_{}.txt", i );
+    std::ofstream( filename ) << std::string( 4096u, static_cast<char>( 'a' + i % 26u ) );
+    line += " " + filename;
+  }
+
+  const auto read = [&]( const std::string& jobs ) {
+    alice::cli<parsed_file> cli( "bench" );
+    cli.insert_read_command<parsed_file_tag_t>( "read_parsed", "Parsed" );
+
+    const auto command = line + jobs;
+    char* args[] = {"", "-c", const_cast<char*>( command.c_str() )};
+    cli.run( 3, args );
+    return cli.env->store<parsed_file>().size();
+  };
+
+  BENCHMARK( "1 job (200 files)" )
+  {
+    return read( "" );
+  };
+
+  BENCHMARK( "all cores (200 files)" )
+  {
+    return read( " --jobs 0" );
+  };
+
+  for ( auto i = 0u; i < num_files; ++i )
+  {
+    std::remove( fmt::format( "/tmp/alice_bench_{}.txt", i ).c_str() );
+  }
+}
@@ -1,7 +1,17 @@
 #include <catch.hpp>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
 
 #include <alice/alice.hpp>
 
@@ -35,6 +45,221 @@ protected:
   }
 };
 
+class options_command : public command
+{
+public:
+  explicit options_command( const environment::ptr& env ) : command( env, "Command with options" )
+  {
+    add_flag( "-v,--verbose", verbose, "be verbose" );
+    add_option( "-n,--number", number, "some number" );
+    add_option( "--pair", pair, "two strings" )->expected( 2 );
+    add_option( "--name", name, "some name" );
+    add_option( "files", files, "files" );
+  }
+
+protected:
+  void execute()
+  {
+    env->out() << fmt::format( "{} {} {} {} [{}]", verbose, number, fmt::join( pair, "," ), name, fmt::join( files, "," ) ) << std::endl;
+    verbose = false;
+    number = 0;
+    pair.clear();
+    name.clear();
+    files.clear();
+  }
+
+private:
+  bool verbose{false};
+  int number{0};
+  std::vector<std::string> pair;
+  std::string name;
+  std::vector<std::string> files;
+};
+
+class handles_command : public command
+{
+public:
+  explicit handles_command( const environment::ptr& env ) : command( env, "Command with anonymous options" )
+  {
+    for ( auto i = 0u; i < 20u; ++i )
+    {
+      add_option<int>( fmt::format( "--o{}", i ), "some number" );
+    }
+    number = add_option<int>( "-n,--number", "some number" );
+    number->required();
+  }
+
+protected:
+  void execute()
+  {
+    const auto o19 = find_option<int>( "--o19" );
+    env->out() << fmt::format( "{} {} {} {} {}", *number, o19.value_or( -1 ), option_value<int>( "--o19" ), option_value<int>( "--o18", 42 ), static_cast<bool>( find_option<std::string>( "--o19" ) ) ) << std::endl;
+  }
+
+private:
+  option_handle<int> number;
+};
+
+class flags_command : public command
+{
+public:
+  explicit flags_command( const environment::ptr& env ) : command( env, "Command with flags" )
+  {
+    add_flag( "-v,--verbose", "be verbose" );
+    add_flag( "--x", "some flag" );
+  }
+
+protected:
+  void execute()
+  {
+    env->out() << fmt::format( "{} {} {} {} {}", is_set( "v" ), is_set( "-v" ), is_set( "verbose" ), is_set( "x" ), is_set( "unknown" ) ) << std::endl;
+  }
+};
+
+class rules_command : public command
+{
+public:
+  explicit rules_command( const environment::ptr& env ) : command( env, "Command with rules" )
+  {
+    add_flag( "-a", "flag a" );
+    add_flag( "-b", "flag b" );
+
+    add_rule( [this]() { return !( is_set( "a" ) && is_set( "b" ) ); }, "not both -a and -b can be set" );
+    add_rule( has_store_element<std::string>( env ) );
+    add_rule( [this]() { return !is_set( "b" ); }, [this]() { return fmt::format( "-b cannot be used with {} strings", store<std::string>().size() ); } );
+  }
+
+protected:
+  rules validity_rules() const
+  {
+    return {has_store_element_if_set<std::string>( *this, env, "a" )};
+  }
+
+  void execute()
+  {
+    env->out() << "ok" << std::endl;
+  }
+};
+
+class length_command : public command
+{
+public:
+  explicit length_command( const environment::ptr& env ) : command( env, "Pure command that reads strings" )
+  {
+    add_flag( "-v,--verbose", "be verbose" );
+    reads_store<std::string>();
+    set_pure();
+  }
+
+protected:
+  void execute()
+  {
+    ++executions;
+    const auto length = store<std::string>().current().size();
+    env->out() << ( is_set( "verbose" ) ? fmt::format( "length is {}", length ) : std::to_string( length ) ) << std::endl;
+  }
+
+  nlohmann::json log() const
+  {
+    return {{"executions", executions}};
+  }
+
+public:
+  unsigned executions{0u};
+};
+
+class greet_command : public command
+{
+public:
+  explicit greet_command( const environment::ptr& env ) : command( env, "Pure command that writes strings" )
+  {
+    writes_store<std::string>();
+    set_pure();
+  }
+
+protected:
+  void execute()
+  {
+    ++executions;
+    store<std::string>().extend() = "Hi";
+  }
+
+public:
+  unsigned executions{0u};
+};
+
+class number_command : public command
+{
+public:
+  explicit number_command( const environment::ptr& env ) : command( env, "Pure command with an option" )
+  {
+    add_option( "--n", n, "number" );
+    set_pure();
+  }
+
+protected:
+  void execute()
+  {
+    ++executions;
+    env->out() << "n=" << n << std::endl;
+  }
+
+public:
+  unsigned n{1u};
+  unsigned executions{0u};
+};
+
+class rewrite_command : public command
+{
+public:
+  explicit rewrite_command( const environment::ptr& env ) : command( env, "Rewrites a file" )
+  {
+    add_option( "filename", filename, "filename" )->required();
+    add_option( "--contents", contents, "new contents" );
+    add_flag( "--keep_time", "keep modification time" );
+  }
+
+protected:
+  void execute()
+  {
+    const auto mtime = std::filesystem::last_write_time( filename );
+    std::ofstream( filename ) << contents;
+    std::filesystem::last_write_time( filename, is_set( "keep_time" ) ? mtime : mtime + std::chrono::seconds( 1 ) );
+  }
+
+private:
+  std::string filename;
+  std::string contents;
+};
+
+class sleep_command : public command
+{
+public:
+  explicit sleep_command( const environment::ptr& env ) : command( env, "Waits until time is up or it is cancelled" )
+  {
+    add_option( "ms", ms, "milliseconds" )->required();
+  }
+
+protected:
+  void execute()
+  {
+    const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds( ms );
+    while ( !env->cancelled() && std::chrono::steady_clock::now() < until )
+    {
+      std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+    }
+    env->out() << ( env->cancelled() ? "cancelled" : "slept" ) << std::endl;
+  }
+
+  nlohmann::json log() const
+  {
+    return {{"ms", ms}};
+  }
+
+private:
+  unsigned ms{0u};
+};
+
 struct io_file_tag_t;
 
 template<>
@@ -45,6 +270,38 @@ bool can_write<std::string, io_file_tag_t>( command& cmd )
   return true;
 }
 
+template<>
+bool can_read<std::string, io_file_tag_t>( command& cmd )
+{
+  (void)cmd;
+  return true;
+}
+
+template<>
+std::string read<std::string, io_file_tag_t>( std::istream& is, const command& cmd )
+{
+  (void)cmd;
+  return std::string( std::istreambuf_iterator<char>( is ), std::istreambuf_iterator<char>() );
+}
+
+template<>
+std::string read<std::string, io_file_tag_t>( const std::string& filename, const command& cmd )
+{
+  std::ifstream in( filename );
+  auto contents = read<std::string, io_file_tag_t>( in, cmd );
+  if ( contents == "bad" )
+  {
+    throw fmt::format( "cannot parse {}", filename );
+  }
+  return contents;
+}
+
+template<>
+void write<std::string, io_file_tag_t>( const std::string& element, std::ostream& os, const command& cmd )
+{
+  os << element << ( cmd.is_set( "-p" ) ? "!" : "" );
+}
+
 template<>
 void write<std::string, io_file_tag_t>( const std::string& element, const std::string& filename, const command& cmd )
 {
@@ -89,3 +346,842 @@ TEST_CASE( "Adding commands to CLI", "[cli]" )
                        "write Hello world to file2\n"
                        "abc\n" );
 }
+
+TEST_CASE( "Commands are dispatched through perfect hash table", "[cli]" )
+{
+  alice::cli<std::string> cli( "test" );
+
+  std::stringstream sstr;
+  cli.env->reroute( sstr, sstr );
+
+  constexpr std::array<std::string_view, 2> names = {"test", "store"};
+  cli.set_command_table( detail::make_perfect_hash( names ) );
+
+  /* test is inserted after the table has been set, write_file is not part of it */
+  cli.insert_command( "test", std::make_shared<test_command>( cli.env ) );
+  cli.insert_write_command<io_file_tag_t>( "write_file", "File" );
+
+  char* args[] = {"", "-c", "test; store -s; write_file file; unknown"};
+  cli.run( 3, args );
+
+  CHECK( sstr.str() == "Hello world\n"
+                       "[i] strings in store:\n"
+                       "  *  0: \n"
+                       "write Hello world to file\n"
+                       "[e] unknown command: unknown\n" );
+}
+
+TEST_CASE( "Scripts are compiled before execution", "[cli]" )
+{
+  alice::cli<std::string> cli( "test" );
+
+  std::stringstream sstr;
+  cli.env->reroute( sstr, sstr );
+  cli.insert_command( "test", std::make_shared<test_command>( cli.env ) );
+
+  const std::string filename = "alice_test_script.txt";
+  {
+    std::ofstream os( filename );
+    os << "# comment\n"
+       << "alias t test\n"
+       << "t; store -s\n"
+       << "tset\n"
+       << "store -s \"abc\n"
+       << "<does_not_exist.txt\n";
+  }
+
+  char* args[] = {"", "-f", const_cast<char*>( filename.c_str() )};
+  cli.run( 3, args );
+
+  CHECK( sstr.str() == "[e] alice_test_script.txt:4: unknown command: tset\n"
+                       "[e] alice_test_script.txt:5: unterminated quote\n" );
+
+  {
+    std::ofstream os( filename );
+    os << "alias t test\n"
+       << "t; store -s\n"
+       << "store -s; t\n";
+  }
+
+  alice::cli<std::string> cli2( "test" );
+  sstr.str( "" );
+  cli2.env->reroute( sstr, sstr );
+  cli2.insert_command( "test", std::make_shared<test_command>( cli2.env ) );
+  cli2.run( 3, args );
+
+  CHECK( sstr.str() == "Hello world\n"
+                       "[i] strings in store:\n"
+                       "  *  0: \n"
+                       "[i] strings in store:\n"
+                       "  *  0: \n"
+                       "Hello world\n" );
+
+  /* all lines are echoed */
+  {
+    std::ofstream os( filename );
+    os << "# comment\n"
+       << "\n"
+       << "test\n"
+       << "# end\n";
+  }
+
+  alice::cli<std::string> cli3( "test" );
+  sstr.str( "" );
+  cli3.env->reroute( sstr, sstr );
+  cli3.insert_command( "test", std::make_shared<test_command>( cli3.env ) );
+  char* echo_args[] = {"", "-e", "-f", const_cast<char*>( filename.c_str() )};
+  cli3.run( 4, echo_args );
+
+  CHECK( sstr.str() == "test> # comment\n"
+                       "test> \n"
+                       "test> test\n"
+                       "Hello world\n"
+                       "test> # end\n" );
+
+  /* aliases are defined and files are included when the operations are executed */
+  {
+    std::ofstream os( filename );
+    os << "if 0 { alias u test }\n"
+       << "u\n"
+       << "!echo test > /tmp/alice_generated.txt\n"
+       << "</tmp/alice_generated.txt\n"
+       << "<does_not_exist.txt\n";
+  }
+
+  alice::cli<std::string> cli4( "test" );
+  sstr.str( "" );
+  cli4.env->reroute( sstr, sstr );
+  cli4.insert_command( "test", std::make_shared<test_command>( cli4.env ) );
+  cli4.run( 3, args );
+  std::remove( filename.c_str() );
+  std::remove( "/tmp/alice_generated.txt" );
+
+  CHECK( sstr.str() == "[e] unknown command: u\n"
+                       "Hello world\n"
+                       "[e] alice_test_script.txt:5: file does_not_exist.txt not found\n" );
+
+  /* included files are compiled with the script, errors are reported before anything runs */
+  std::ofstream( "/tmp/alice_setup.txt" ) << "alias hi test\n";
+  {
+    std::ofstream os( filename );
+    os << "test\n"
+       << "</tmp/alice_setup.txt\n"
+       << "hi\n"
+       << "tset -s\n";
+  }
+
+  alice::cli<std::string> cli5( "test" );
+  sstr.str( "" );
+  cli5.env->reroute( sstr, sstr );
+  cli5.insert_command( "test", std::make_shared<test_command>( cli5.env ) );
+  cli5.run( 3, args );
+
+  CHECK( sstr.str() == "[e] alice_test_script.txt:4: unknown command: tset\n" );
+
+  std::ofstream( filename ) << "test\n</tmp/alice_setup.txt\nhi\n";
+
+  alice::cli<std::string> cli6( "test" );
+  sstr.str( "" );
+  cli6.env->reroute( sstr, sstr );
+  cli6.insert_command( "test", std::make_shared<test_command>( cli6.env ) );
+  cli6.run( 3, args );
+  std::remove( filename.c_str() );
+  std::remove( "/tmp/alice_setup.txt" );
+
+  CHECK( sstr.str() == "Hello world\nHello world\n" );
+}
+
+TEST_CASE( "Recursive aliases are expanded up to a fixed depth", "[cli]" )
+{
+  alice::cli<std::string> cli( "test" );
+
+  std::stringstream sstr;
+  cli.env->reroute( sstr, sstr );
+  cli.insert_command( "test", std::make_shared<test_command>( cli.env ) );
+
+  char* args[] = {"", "-c", "alias a1 a2; alias a2 test; alias loop loop; alias \"(abc\" abc; a1; loop"};
+  cli.run( 3, args );
+
+  CHECK( sstr.str() == "[e] invalid alias (abc: " + std::string( std::regex_error( std::regex_constants::error_paren ).what() ) + "\n"
+                       "Hello world\n"
+                       "[e] alias expansion of loop exceeds 32 steps\n" );
+}
+
+TEST_CASE( "Alias expansions are cached", "[cli]" )
+{
+  alice::cli<std::string> cli( "test" );
+
+  std::stringstream sstr;
+  cli.env->reroute( sstr, sstr );
+  cli.insert_command( "test", std::make_shared<test_command>( cli.env ) );
+
+  /* the second alias invalidates the cached expansion of t */
+  char* args[] = {"", "-c", "alias t test; t; t; t; alias t \"store -s\"; t; alias --stats; alias"};
+  cli.run( 3, args );
+
+  CHECK( sstr.str() == "Hello world\n"
+                       "Hello world\n"
+                       "Hello world\n"
+                       "[i] strings in store:\n"
+                       "     0: \n"
+                       "     1: \n"
+                       "  *  2: \n"
+                       "[i] alias cache: 2 hits, 4 misses, 2/1024 entries\n"
+                       "[e] alias and expansion need to be specified\n" );
+}
+
+TEST_CASE( "Options are parsed with precompiled schema", "[cli]" )
+{
+  const auto run = []( const std::string& line ) {
+    alice::cli<std::string> cli( "test" );
+
+    std::stringstream sstr;
+    cli.env->reroute( sstr, sstr );
+    cli.insert_command( "opts", std::make_shared<options_command>( cli.env ) );
+
+    char* args[] = {"", "-c", const_cast<char*>( line.c_str() )};
+    cli.run( 3, args );
+    return sstr.str();
+  };
+
+  CHECK( run( "opts a b; opts -vn 5 --name=x a; opts -n7 --pair c d \"e f\"; opts --name=\"g h\" --verbose" ) ==
+         "false 0   [a,b]\n"
+         "true 5  x [a]\n"
+         "false 7 c,d  [e f]\n"
+         "true 0  g h []\n" );
+
+  /* errors are reported by CLI11 */
+  CHECK( run( "opts -x" ) == "[e] The following argument was not expected: -x\n" );
+  CHECK( run( "opts -n" ) == "[e] --number: 1 required INT missing\n" );
+  CHECK( run( "opts -n abc" ) == "[e] Could not convert: -n, --number = abc\n" );
+  CHECK( run( "opts --pair c" ) == "[e] --pair: 1 required TEXT missing\n" );
+}
+
+TEST_CASE( "Anonymous options are accessed through typed handles", "[cli]" )
+{
+  alice::cli<std::string> cli( "test" );
+
+  std::stringstream sstr;
+  cli.env->reroute( sstr, sstr );
+  cli.insert_command( "handles", std::make_shared<handles_command>( cli.env ) );
+
+  char* args[] = {"", "-c", "handles --number 5; handles --o19 3 -n 4; handles"};
+  cli.run( 3, args );
+
+  CHECK( sstr.str() == "5 -1 0 0 false\n"
+                       "4 3 3 0 false\n"
+                       "[e] --number is required\n" );
+}
+
+TEST_CASE( "Check whether options are set", "[cli]" )
+{
+  alice::cli<std::string> cli( "test" );
+
+  std::stringstream sstr;
+  cli.env->reroute( sstr, sstr );
+  cli.insert_command( "flags", std::make_shared<flags_command>( cli.env ) );
+
+  char* args[] = {"", "-c", "flags -v; flags --x; store --string; store -s; convert"};
+  cli.run( 3, args );
+
+  CHECK( sstr.str() == "true true true false false\n"
+                       "false false false true false\n"
+                       "[w] no string in store\n"
+                       "[w] no string in store\n" );
+}
+
+TEST_CASE( "Rules are checked before execution", "[cli]" )
+{
+  const auto run = []( const std::string& line ) {
+    alice::cli<std::string> cli( "test" );
+
+    std::stringstream sstr;
+    cli.env->reroute( sstr, sstr );
+    cli.insert_command( "rules", std::make_shared<rules_command>( cli.env ) );
+    cli.insert_command( "test", std::make_shared<test_command>( cli.env ) );
+
+    char* args[] = {"", "-c", const_cast<char*>( line.c_str() )};
+    cli.run( 3, args );
+    return sstr.str();
+  };
+
+  CHECK( run( "rules -a -b" ) == "[e] not both -a and -b can be set\n" );
+  CHECK( run( "rules" ) == "[e] no current string available\n" );
+  CHECK( run( "test; rules -a" ) == "Hello world\nok\n" );
+  CHECK( run( "test; test; rules -b" ) == "Hello world\nHello world\n[e] -b cannot be used with 2 strings\n" );
+}
+
+TEST_CASE( "Arguments are read from response files", "[cli]" )
+{
+  {
+    std::ofstream os( "/tmp/alice_response.txt", std::ofstream::out );
+    os << "a.txt\n"
+       << "file with spaces.txt\r\n"
+       << "\n"
+       << "--name\n"
+       << "some name\n";
+  }
+
+  const auto run = []( const std::string& line ) {
+    alice::cli<std::string> cli( "test" );
+
+    std::stringstream sstr;
+    cli.env->reroute( sstr, sstr );
+    cli.insert_command( "opts", std::make_shared<options_command>( cli.env ) );
+
+    char* args[] = {"", "-c", const_cast<char*>( line.c_str() )};
+    cli.run( 3, args );
+    return sstr.str();
+  };
+
+  CHECK( run( "opts @/tmp/alice_response.txt" ) == "false 0  some name [a.txt,file with spaces.txt]\n" );
+  CHECK( run( "opts -v b.txt @/tmp/alice_response.txt c.txt" ) == "true 0  some name [b.txt,a.txt,file with spaces.txt,c.txt]\n" );
+  CHECK( run( "opts @/tmp/alice_response.txt -x" ) == "[e] The following argument was not expected: -x\n" );
+  CHECK( run( "opts \"@a.txt\"" ) == "false 0   [@a.txt]\n" );
+  CHECK( run( "opts @/tmp/alice_missing.txt" ) == "[e] cannot read response file /tmp/alice_missing.txt\n" );
+
+  std::remove( "/tmp/alice_response.txt" );
+}
+
+TEST_CASE( "Executions of pure commands are cached", "[cli]" )
+{
+  alice::cli<std::string> cli( "test" );
+
+  std::stringstream sstr;
+  cli.env->reroute( sstr, sstr );
+  const auto length = std::make_shared<length_command>( cli.env );
+  const auto greet = std::make_shared<greet_command>( cli.env );
+  cli.insert_command( "test", std::make_shared<test_command>( cli.env ) );
+  cli.insert_command( "length", length );
+  cli.insert_command( "greet", greet );
+
+  char* args[] = {"", "-l", "/tmp/alice_pure.json", "-c", "test; length; print -s; length; length -v; greet; length; greet; length; length; store -s"};
+  cli.run( 5, args );
+
+  CHECK( sstr.str() == "Hello world\n"
+                       "11\n"
+                       "\n"
+                       "11\n"
+                       "length is 11\n"
+                       "2\n"
+                       "2\n"
+                       "2\n"
+                       "[i] strings in store:\n"
+                       "     0: \n"
+                       "     1: \n"
+                       "  *  2: \n" );
+
+  CHECK( length->executions == 4u );
+  CHECK( greet->executions == 1u );
+
+  std::ifstream in( "/tmp/alice_pure.json" );
+  nlohmann::json log;
+  in >> log;
+  std::remove( "/tmp/alice_pure.json" );
+
+  REQUIRE( log.size() == 11u );
+  CHECK( log[1]["cache"]["hit"] == false );
+  CHECK( log[3]["cache"]["hit"] == true );
+  CHECK( log[3]["executions"] == 1 );
+  CHECK( log[4]["cache"]["hit"] == false );
+  CHECK( log[7]["cache"]["hit"] == true );
+  CHECK( log[8]["cache"]["hit"] == false ); /* greet changed the store */
+  CHECK( log[9]["cache"]["hit"] == true );
+  CHECK( log[9]["cache"]["hits"] == 3 );
+  CHECK( log[9]["cache"]["misses"] == 5 );
+}
+
+TEST_CASE( "Pure commands are cached with the values of earlier options", "[cli]" )
+{
+  alice::cli<std::string> cli( "test" );
+
+  std::stringstream sstr;
+  cli.env->reroute( sstr, sstr );
+  const auto number = std::make_shared<number_command>( cli.env );
+  cli.insert_command( "number", number );
+
+  /* the option keeps its value from the last call that gave it */
+  char* args[] = {"", "-c", "number; number; number --n 2; number; number --n 3; number --n 2; number --n 3; number"};
+  cli.run( 3, args );
+
+  CHECK( sstr.str() == "n=1\nn=1\nn=2\nn=2\nn=3\nn=2\nn=3\nn=3\n" );
+  CHECK( number->executions == 6u );
+  CHECK( number->n == 3u );
+}
+
+TEST_CASE( "Run command for each store element", "[cli]" )
+{
+  const auto run = []( const std::string& line ) {
+    alice::cli<std::string> cli( "test" );
+
+    std::stringstream sstr;
+    cli.env->reroute( sstr, sstr );
+    cli.insert_command( "test", std::make_shared<test_command>( cli.env ) );
+    cli.insert_command( "greet", std::make_shared<greet_command>( cli.env ) );
+    cli.insert_command_type<length_command>( "length" );
+    cli.insert_command( "rules", std::make_shared<rules_command>( cli.env ) );
+
+    char* args[] = {"", "-c", const_cast<char*>( line.c_str() )};
+    cli.run( 3, args );
+    return sstr.str();
+  };
+
+  CHECK( run( "greet; test; greet; foreach -s length -v; store -s" ) == "Hello world\n"
+                                                                        "length is 2\n"
+                                                                        "length is 11\n"
+                                                                        "length is 2\n"
+                                                                        "[i] strings in store:\n"
+                                                                        "     0: \n"
+                                                                        "     1: \n"
+                                                                        "  *  2: \n" );
+  CHECK( run( "greet; test; greet; test; foreach -s --jobs 3 length" ) == "Hello world\nHello world\n2\n11\n2\n11\n" );
+  CHECK( run( "test; foreach -s --jobs 2 rules -b" ) == "Hello world\n[e] -b cannot be used with 1 strings\n" );
+  CHECK( run( "test; test; foreach -s --jobs 2 rules" ) == "Hello world\nHello world\n[w] command rules cannot run in parallel\nok\nok\n" );
+  CHECK( run( "foreach -s" ) == "[e] no command specified\n" );
+  CHECK( run( "foreach length" ) == "[e] exactly one store needs to be specified\n" );
+  CHECK( run( "test; foreach -s nope" ) == "Hello world\n[e] unknown command: nope\n" );
+  CHECK( run( "greet; test; foreach -s foreach -s length" ) == "Hello world\n2\n11\n2\n11\n" );
+
+  /* elements cannot be added or removed while iterating over them */
+  CHECK( run( "greet; greet; foreach -s greet; foreach -s store --pop -s; store -s" ) == "[e] cannot add or remove string elements while iterating over the store\n"
+                                                                                         "[e] cannot add or remove string elements while iterating over the store\n"
+                                                                                         "[e] cannot add or remove string elements while iterating over the store\n"
+                                                                                         "[e] cannot add or remove string elements while iterating over the store\n"
+                                                                                         "[i] strings in store:\n"
+                                                                                         "     0: \n"
+                                                                                         "  *  1: \n" );
+}
+
+TEST_CASE( "Included files are cached", "[cli]" )
+{
+  std::ofstream( "/tmp/alice_include.txt" ) << "test\n";
+  std::ofstream( "/tmp/alice_recursive.txt" ) << "test\n<  /tmp/alice_recursive.txt\n";
+
+  const auto run = []( const std::string& line ) {
+    alice::cli<std::string> cli( "test" );
+
+    std::stringstream sstr;
+    cli.env->reroute( sstr, sstr );
+    cli.insert_command( "test", std::make_shared<test_command>( cli.env ) );
+    cli.insert_command( "rewrite", std::make_shared<rewrite_command>( cli.env ) );
+    cli.insert_command( "opts", std::make_shared<options_command>( cli.env ) );
+
+    char* args[] = {"", "-c", const_cast<char*>( line.c_str() )};
+    cli.run( 3, args );
+    return sstr.str();
+  };
+
+  /* a file with the same size and modification time is not read again */
+  CHECK( run( "</tmp/alice_include.txt; rewrite /tmp/alice_include.txt --contents #abcd --keep_time; </tmp/alice_include.txt; "
+              "rewrite /tmp/alice_include.txt --contents #abcd; </tmp/alice_include.txt" ) == "Hello world\nHello world\n" );
+
+  CHECK( run( "</tmp/alice_recursive.txt" ) == "[e] /tmp/alice_recursive.txt:2: recursive include of file /tmp/alice_recursive.txt\n" );
+
+  /* an included file that changes while the script runs is compiled again */
+  std::ofstream( "/tmp/alice_inner.txt" ) << "opts before\n";
+  std::ofstream( "/tmp/alice_outer.txt" ) << "</tmp/alice_inner.txt\nrewrite /tmp/alice_inner.txt --contents \"opts after\"\n</tmp/alice_inner.txt\n";
+  CHECK( run( "</tmp/alice_outer.txt" ) == "false 0   [before]\nfalse 0   [after]\n" );
+
+  /* a script does not change if its file is rewritten while it runs */
+  std::ofstream( "/tmp/alice_rewritten.txt" ) << "rewrite /tmp/alice_rewritten.txt --contents #abcd\nopts hello\n";
+  CHECK( run( "</tmp/alice_rewritten.txt; </tmp/alice_rewritten.txt" ) == "false 0   [hello]\n" );
+
+  std::remove( "/tmp/alice_include.txt" );
+  std::remove( "/tmp/alice_recursive.txt" );
+  std::remove( "/tmp/alice_rewritten.txt" );
+  std::remove( "/tmp/alice_inner.txt" );
+  std::remove( "/tmp/alice_outer.txt" );
+}
+
+TEST_CASE( "Variables are substituted in command lines", "[cli]" )
+{
+  std::ofstream( "/tmp/alice_variables.txt" ) << "set f a.txt\nopts $f\nset f \"b c.txt\"\nopts $f\nset c opts\n$c -v\nopts $$f";
+
+  const auto run = []( const std::string& line ) {
+    alice::cli<std::string> cli( "test" );
+
+    std::stringstream sstr;
+    cli.env->reroute( sstr, sstr );
+    cli.insert_command( "opts", std::make_shared<options_command>( cli.env ) );
+
+    char* args[] = {"", "-c", const_cast<char*>( line.c_str() )};
+    cli.run( 3, args );
+    return sstr.str();
+  };
+
+  CHECK( run( "set n 5; set x name; opts -n $n --name=${x}s $x.txt $y" ) == "false 5  names [name.txt,]\n" );
+  CHECK( run( "set c nope; $c" ) == "[e] unknown command: nope\n" );
+  CHECK( run( "set x hi; !echo $x ${x}s $PATH" ) == "hi his " + std::string( std::getenv( "PATH" ) ) + "\n" ); /* undefined variables refer to the shell */
+  CHECK( run( "</tmp/alice_variables.txt" ) == "false 0   [a.txt]\n"
+                                                "false 0   [b c.txt]\n"
+                                                "true 0   []\n"
+                                                "false 0   [$f]\n" );
+
+  std::remove( "/tmp/alice_variables.txt" );
+}
+
+TEST_CASE( "Loops and conditionals in scripts", "[cli]" )
+{
+  std::ofstream( "/tmp/alice_blocks.txt" ) << "set n 2\n"
+                                              "for i in 1..$n {\n"
+                                              "  for j in a b {\n"
+                                              "    opts $i$j\n"
+                                              "  }\n"
+                                              "  if $i == 2 {\n"
+                                              "    opts two\n"
+                                              "  } else {\n"
+                                              "    opts other\n"
+                                              "  }\n"
+                                              "}\n"
+                                              "set k 0\n"
+                                              "while $k != 1 {\n"
+                                              "  set k 1; opts -n $k\n"
+                                              "}\n";
+  std::ofstream( "/tmp/alice_unclosed.txt" ) << "for i in 1..2 {\n  opts $i\n";
+  std::filesystem::create_directories( "/tmp/alice_glob" );
+  for ( const auto* name : {"b.v", "a.v", "c.txt"} )
+  {
+    std::ofstream( std::string( "/tmp/alice_glob/" ) + name );
+  }
+
+  const auto run = []( const std::string& line ) {
+    alice::cli<std::string> cli( "test" );
+
+    std::stringstream sstr;
+    cli.env->reroute( sstr, sstr );
+    cli.insert_command( "opts", std::make_shared<options_command>( cli.env ) );
+
+    char* args[] = {"", "-c", const_cast<char*>( line.c_str() )};
+    cli.run( 3, args );
+    return sstr.str();
+  };
+
+  CHECK( run( "</tmp/alice_blocks.txt" ) == "false 0   [1a]\n"
+                                             "false 0   [1b]\n"
+                                             "false 0   [other]\n"
+                                             "false 0   [2a]\n"
+                                             "false 0   [2b]\n"
+                                             "false 0   [two]\n"
+                                             "false 1   []\n" );
+  CHECK( run( "for i in 3..1 { opts $i }; if ! $i { opts unset }" ) == "false 0   [3]\nfalse 0   [2]\nfalse 0   [1]\n" );
+  CHECK( run( "for i in 1..3 { !echo $i }" ) == "1\n2\n3\n" );
+  CHECK( run( "for i in 1..1000000000 { opts $i; if $i == 2 { quit } }" ) == "false 0   [1]\nfalse 0   [2]\n" );
+  CHECK( run( "for f in /tmp/alice_glob/*.v { opts $f }" ) == "false 0   [/tmp/alice_glob/a.v]\nfalse 0   [/tmp/alice_glob/b.v]\n" );
+  CHECK( run( "for f in /tmp/alice_glob/*.x { opts $f }" ).empty() );
+  CHECK( run( "if 10 > 9 { opts yes }; if abc > abd { opts no }" ) == "false 0   [yes]\n" );
+  CHECK( run( "opts \"{\" }" ) == "[e] command line:1: unexpected }\n" );
+  CHECK( run( "</tmp/alice_unclosed.txt" ) == "[e] /tmp/alice_unclosed.txt:1: missing }\n" );
+
+  /* -c fails if a command in a block fails */
+  alice::cli<std::string> cli( "test" );
+  std::stringstream sstr;
+  cli.env->reroute( sstr, sstr );
+  cli.insert_command( "opts", std::make_shared<options_command>( cli.env ) );
+  char* args[] = {"", "-c", "for i in 1..2 { opts --nope }"};
+  CHECK( cli.run( 3, args ) == 1 );
+
+  std::remove( "/tmp/alice_blocks.txt" );
+  std::remove( "/tmp/alice_unclosed.txt" );
+  std::filesystem::remove_all( "/tmp/alice_glob" );
+}
+
+TEST_CASE( "Commands are connected with pipes", "[cli]" )
+{
+  std::ofstream( "/tmp/alice_pipe.txt" ) << "greet; set f out2\nwrite_file -p | read_file -n\nwrite_file $f\n";
+
+  const auto run = []( const std::string& line ) {
+    alice::cli<std::string> cli( "test" );
+
+    std::stringstream sstr;
+    cli.env->reroute( sstr, sstr );
+    cli.insert_command( "greet", std::make_shared<greet_command>( cli.env ) );
+    cli.insert_read_command<io_file_tag_t>( "read_file", "File" );
+    cli.insert_write_command<io_file_tag_t>( "write_file", "File" );
+
+    char* args[] = {"", "-c", const_cast<char*>( line.c_str() )};
+    cli.run( 3, args );
+    return sstr.str();
+  };
+
+  CHECK( run( "greet; write_file | read_file; write_file out" ) == "write Hi to out\n" );
+  CHECK( run( "greet; write_file -p | read_file -n; write_file out; store -s" ) == "write Hi! to out\n"
+                                                                                 "[i] strings in store:\n"
+                                                                                 "     0: \n"
+                                                                                 "  *  1: \n" );
+  CHECK( run( "</tmp/alice_pipe.txt" ) == "write Hi! to out2\n" );
+  CHECK( run( "read_file" ) == "[e] filename is required\n" );
+  CHECK( run( "greet; write_file -p | read_file -n; read_file" ) == "[e] filename is required\n" );
+  CHECK( run( "read_file /tmp/alice_pipe.txt; greet; write_file | read_file; write_file out" ) == "write Hi to out\n" );
+  CHECK( run( "write_file | read_file" ) == "[w] no string selected in store\n" );
+  CHECK( run( "greet; write_file | unknown" ) == "[e] unknown command: unknown\n" );
+  CHECK( run( "greet; write_file |" ) == "[e] missing command in pipe\n" );
+
+  std::remove( "/tmp/alice_pipe.txt" );
+}
+
+TEST_CASE( "Output is buffered by the environment", "[cli]" )
+{
+  alice::cli<std::string> cli( "test" );
+  cli.insert_command( "test", std::make_shared<test_command>( cli.env ) );
+
+  std::stringstream sstr, other;
+  cli.env->reroute( sstr, sstr );
+
+  /* explicit flushes are ignored, errors write buffered output first */
+  cli.env->set_flush_policy( flush_policy::size );
+  cli.env->out() << "a" << std::endl;
+  CHECK( sstr.str().empty() );
+  cli.env->err() << "b\n";
+  CHECK( sstr.str() == "a\nb\n" );
+
+  /* buffered output is written before rerouting */
+  cli.env->out() << "c\n";
+  cli.env->reroute( other, other );
+  CHECK( sstr.str() == "a\nb\nc\n" );
+
+  /* large output is written when the buffer is full */
+  const std::string block( 2 * detail::output_sink::capacity, 'x' );
+  cli.env->out() << block;
+  CHECK( other.str() == block );
+
+  cli.env->reroute( sstr, sstr );
+  cli.env->set_flush_policy( flush_policy::line );
+  cli.env->out() << "d\n";
+  CHECK( sstr.str() == "a\nb\nc\nd\n" );
+
+  /* output is written after each command and when the shell stops */
+  cli.env->set_flush_policy( flush_policy::command );
+  char* args[] = {"", "-c", "test; test"};
+  cli.run( 3, args );
+  CHECK( sstr.str() == "a\nb\nc\nd\nHello world\nHello world\n" );
+}
+
+TEST_CASE( "Formatted output is printed through the environment", "[cli]" )
+{
+  alice::cli<std::string> cli( "test" );
+
+  std::stringstream sstr;
+  cli.env->reroute( sstr, sstr );
+
+  cli.env->print( "[i] {} has {:>3} nodes\n", "aig", 42 );
+  cli.env->print( "no arguments\n" );
+  cli.env->flush();
+
+  CHECK( sstr.str() == "[i] aig has  42 nodes\nno arguments\n" );
+}
+
+TEST_CASE( "Commands write JSON lines", "[cli]" )
+{
+  const auto run = []( const std::string& line ) {
+    alice::cli<std::string> cli( "test" );
+
+    std::stringstream out, err;
+    cli.env->reroute( out, err );
+    cli.insert_command( "test", std::make_shared<test_command>( cli.env ) );
+
+    char* args[] = {"", "--json", "-c", const_cast<char*>( line.c_str() )};
+    cli.run( 4, args );
+    return out.str();
+  };
+
+  CHECK( run( "test" ) == "{\"command\":\"test\",\"output\":\"Hello world\\n\",\"success\":true}\n" );
+  CHECK( run( "test; test; store -s" ) == "{\"command\":\"test\",\"output\":\"Hello world\\n\",\"success\":true}\n"
+                                          "{\"command\":\"test\",\"output\":\"Hello world\\n\",\"success\":true}\n"
+                                          "{\"command\":\"store -s\",\"contents\":{\"string\":[\"\",\"\"]},\"string\":1,\"success\":true}\n" );
+  CHECK( run( "store -s" ) == "{\"command\":\"store -s\",\"output\":\"[w] no string in store\\n\",\"string\":-1,\"success\":true}\n" );
+  CHECK( run( "test --unknown" ) == "{\"command\":\"test --unknown\",\"errors\":\"[e] The following argument was not expected: --unknown\\n\",\"success\":false}\n" );
+  CHECK( run( "!echo hi" ) == "{\"command\":\"!echo hi\",\"output\":\"hi\\n\",\"status\":0,\"success\":true}\n" );
+  CHECK( run( "!exit 3" ) == "{\"command\":\"!exit 3\",\"output\":\"\",\"status\":3,\"success\":true}\n" );
+}
+
+TEST_CASE( "Commands run in the background", "[cli]" )
+{
+  const auto run = []( const std::string& line, std::vector<std::string> flags = {} ) {
+    alice::cli<std::string> cli( "test" );
+
+    std::stringstream sstr;
+    cli.env->reroute( sstr, sstr );
+    cli.insert_command( "test", std::make_shared<test_command>( cli.env ) );
+    cli.insert_command_type<sleep_command>( "sleep" );
+
+    std::vector<char*> args{""};
+    for ( auto& flag : flags )
+    {
+      args.push_back( const_cast<char*>( flag.c_str() ) );
+    }
+    args.push_back( "-c" );
+    args.push_back( const_cast<char*>( line.c_str() ) );
+    cli.run( static_cast<int>( args.size() ), args.data() );
+    return sstr.str();
+  };
+
+  CHECK( run( "sleep 10 &; wait" ) == "[i] job 1 started: sleep 10\n"
+                                       "[i] job 1 done: sleep 10\n"
+                                       "slept\n" );
+  CHECK( run( "sleep 10000 &; sleep 500 &; jobs; kill 1; wait 1; wait" ) == "[i] job 1 started: sleep 10000\n"
+                                                                            "[i] job 2 started: sleep 500\n"
+                                                                            "[1] running  sleep 10000\n"
+                                                                            "[2] running  sleep 500\n"
+                                                                            "[i] job 1 killed: sleep 10000\n"
+                                                                            "cancelled\n"
+                                                                            "[i] job 2 done: sleep 500\n"
+                                                                            "slept\n" );
+  CHECK( run( "set t 5; sleep $t &" ) == "[i] job 1 started: sleep $t\n"
+                                         "[i] job 1 done: sleep $t\n"
+                                         "slept\n" );
+  CHECK( run( "for i in 1..2 { sleep 1 & }; wait; sleep 1 &" ) == "[i] job 1 started: sleep 1\n"
+                                                                   "[i] job 2 started: sleep 1\n"
+                                                                   "[i] job 1 done: sleep 1\n"
+                                                                   "slept\n"
+                                                                   "[i] job 2 done: sleep 1\n"
+                                                                   "slept\n"
+                                                                   "[i] job 1 started: sleep 1\n"
+                                                                   "[i] job 1 done: sleep 1\n"
+                                                                   "slept\n" );
+  CHECK( run( "test &" ) == "[e] command test cannot run in the background\n" );
+  CHECK( run( "wait 3" ) == "[e] job does not exist\n" );
+  CHECK( run( "sleep 1 &", {"--json"} ).find( "{\"command\":\"sleep 1\",\"finish\":" ) != std::string::npos );
+
+  /* the log contains start and finish time */
+  run( "sleep 1 &", {"-l", "/tmp/alice_jobs.json"} );
+  const auto log = nlohmann::json::parse( std::ifstream( "/tmp/alice_jobs.json" ) );
+  CHECK( log.size() == 1u );
+  CHECK( log[0]["command"] == "sleep 1" );
+  CHECK( log[0]["job"] == 1 );
+  CHECK( log[0]["ms"] == 1 );
+  CHECK( log[0].contains( "time" ) );
+  CHECK( log[0].contains( "finish" ) );
+  std::remove( "/tmp/alice_jobs.json" );
+}
+
+TEST_CASE( "Commands run in parallel blocks", "[cli]" )
+{
+  std::ofstream( "/tmp/alice_parallel.txt" ) << "parallel {\n  sleep 30\n  sleep 10; sleep 20\n  !echo shell\n}\nsleep 1\n";
+
+  const auto run = []( const std::string& line ) {
+    alice::cli<std::string> cli( "test" );
+
+    std::stringstream sstr;
+    cli.env->reroute( sstr, sstr );
+    cli.insert_command( "test", std::make_shared<test_command>( cli.env ) );
+    cli.insert_command_type<sleep_command>( "sleep" );
+    cli.insert_command_type<length_command>( "length" );
+
+    char* args[] = {"", "-c", const_cast<char*>( line.c_str() )};
+    cli.run( 3, args );
+    return sstr.str();
+  };
+
+  /* output in source order, although the first command finishes last */
+  CHECK( run( "</tmp/alice_parallel.txt" ) == "slept\nslept\nslept\nshell\nslept\n" );
+  CHECK( run( "set t 5; parallel 2 { sleep $t; sleep 1 }" ) == "slept\nslept\n" );
+  CHECK( run( "parallel { test; sleep 1 }" ) == "[w] command test cannot run in parallel, block runs sequentially\n"
+                                                "Hello world\n"
+                                                "slept\n" );
+  CHECK( run( "parallel { sleep 1; sleep; length -x }" ) == "slept\n"
+                                                           "[e] ms is required\n"
+                                                           "[e] The following argument was not expected: -x\n"
+                                                           "[e] command line:1: command in parallel block failed: sleep\n" );
+  CHECK( run( "parallel { for i in 1..2 { sleep 1 } }" ) == "[e] command line:1: only commands can run in a parallel block\n" );
+  CHECK( run( "parallel x { sleep 1 }" ) == "[e] command line:1: expected parallel [<jobs>] {\n"
+                                            "[e] command line:1: unexpected }\n" );
+
+  std::remove( "/tmp/alice_parallel.txt" );
+}
+
+TEST_CASE( "Stores are locked for reading and writing", "[cli]" )
+{
+  alice::cli<std::string> cli( "test" );
+  auto& store = cli.env->store<std::string>();
+
+  /* guards of the same thread do not lock again, but cannot upgrade */
+  {
+    const auto reader = store.read();
+    const auto nested = store.read();
+    CHECK( reader->empty() );
+    CHECK_THROWS_AS( store.write(), std::logic_error );
+  }
+  {
+    auto writer = store.write();
+    writer->extend() = "a";
+    CHECK( store.read()->size() == 1u );
+  }
+
+  /* writers wait for readers */
+  std::atomic<bool> written{false};
+  std::thread writer;
+  {
+    const auto reader = store.read();
+    writer = std::thread( [&]() {
+      store.write()->extend() = "b";
+      written = true;
+    } );
+    std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+    CHECK( !written );
+  }
+  writer.join();
+  CHECK( written );
+  CHECK( store.read()->size() == 2u );
+
+  /* commands lock the stores that they declare */
+  std::stringstream sstr;
+  cli.env->reroute( sstr, sstr );
+  auto greet = std::make_shared<greet_command>( cli.env );
+  cli.insert_command( "greet", greet );
+
+  std::thread t;
+  {
+    const auto reader = store.read();
+    t = std::thread( [&]() {
+      char* args[] = {"", "-c", "greet"};
+      cli.run( 3, args );
+    } );
+    std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+    CHECK( greet->executions == 0u );
+  }
+  t.join();
+  CHECK( greet->executions == 1u );
+  CHECK( store.read()->size() == 3u );
+}
+
+TEST_CASE( "Files are read in parallel", "[cli]" )
+{
+  std::string files;
+  for ( auto i = 0u; i < 20u; ++i )
+  {
+    const auto filename = fmt::format( "/tmp/alice_read_{}.txt", i );
+    std::ofstream( filename ) << ( i % 7u == 3u ? "bad" : fmt::format( "f{}", i ) );
+    files += " " + filename;
+  }
+
+  const auto run = []( const std::string& line ) {
+    alice::cli<std::string> cli( "test" );
+
+    std::stringstream sstr;
+    cli.env->reroute( sstr, sstr );
+    cli.insert_read_command<io_file_tag_t>( "read_file", "File" );
+
+    char* args[] = {"", "-c", const_cast<char*>( line.c_str() )};
+    cli.run( 3, args );
+    return std::make_pair( sstr.str(), cli.env->store<std::string>().data() );
+  };
+
+  /* same result for any number of jobs, elements in the order of the files */
+  const auto [output, elements] = run( "read_file" + files );
+  CHECK( output == "[e] cannot parse /tmp/alice_read_3.txt\n"
+                   "[e] cannot parse /tmp/alice_read_10.txt\n"
+                   "[e] cannot parse /tmp/alice_read_17.txt\n"
+                   "[e] 3 of 20 files could not be read\n" );
+  CHECK( elements.size() == 17u );
+  CHECK( elements.front() == "f0" );
+  CHECK( elements.back() == "f19" );
+
+  CHECK( run( "read_file --jobs 4" + files ) == std::make_pair( output, elements ) );
+  CHECK( run( "read_file --jobs 0" + files ) == std::make_pair( output, elements ) );
+  CHECK( run( "read_file --jobs 4 /tmp/alice_read_0.txt; read_file /tmp/alice_read_1.txt" ).second == std::vector<std::string>{"f1"} );
+
+  for ( auto i = 0u; i < 20u; ++i )
+  {
+    std::remove( fmt::format( "/tmp/alice_read_{}.txt", i ).c_str() );
+  }
+}
@@ -1,8 +1,21 @@
 #include <catch.hpp>
 
+#include <array>
+#include <cstdio>
+#include <istream>
+#include <ostream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
+#include <alice/detail/alias_matcher.hpp>
+#include <alice/detail/command_table.hpp>
+#include <alice/detail/interpolation.hpp>
+#include <alice/detail/line_reader.hpp>
+#include <alice/detail/lru_cache.hpp>
+#include <alice/detail/mapped_file.hpp>
+#include <alice/detail/pipe.hpp>
 #include <alice/detail/utils.hpp>
 
 using namespace alice::detail;
@@ -21,3 +34,192 @@ TEST_CASE( "split command into parts", "[utils]" )
   CHECK( split_with_quotes<' '>( "read -n 10 --log \"a b\" filename" ) == std::vector<std::string>{ "read", "-n", "10", "--log", "\"a b\"", "filename" } );
 }
 
+
+TEST_CASE( "perfect hash for command names", "[utils]" )
+{
+  constexpr std::array<std::string_view, 6> names = {"alias", "help", "ps", "read_aiger", "help", "write_aiger"};
+  constexpr auto table = make_perfect_hash( names );
+
+  static_assert( table.slot( "ps" ) >= 0 );
+  static_assert( table.slot( "p" ) == -1 );
+
+  for ( const auto& name : names )
+  {
+    CHECK( table.slot( name ) >= 0 );
+    CHECK( table.keys[table.slot( name )] == name );
+  }
+  CHECK( table.slot( "" ) == -1 );
+  CHECK( table.slot( "read_" ) == -1 );
+  CHECK( table.slot( "write_aigerx" ) == -1 );
+}
+
+TEST_CASE( "tokenize command lines", "[utils]" )
+{
+  line_tokenizer tokenizer;
+
+  const auto tokens_of = [&]( std::size_t i ) {
+    const auto& cmd = tokenizer.commands()[i];
+    return std::vector<std::string_view>( tokenizer.begin( cmd ), tokenizer.end( cmd ) );
+  };
+
+  CHECK( tokenizer.tokenize( "read -n 10 --log \"a b\" filename" ) );
+  CHECK( tokenizer.commands().size() == 1u );
+  CHECK( tokens_of( 0 ) == std::vector<std::string_view>{"read", "-n", "10", "--log", "\"a b\"", "filename"} );
+
+  CHECK( tokenizer.tokenize( "  read   \"a; \\\"b; c\\\"\";  write  ;; " ) );
+  CHECK( tokenizer.commands().size() == 2u );
+  CHECK( tokenizer.commands()[0].text == "read   \"a; \\\"b; c\\\"\"" );
+  CHECK( tokens_of( 0 ) == std::vector<std::string_view>{"read", "\"a; \\\"b; c\\\"\""} );
+  CHECK( tokenizer.commands()[1].text == "write" );
+  CHECK( tokens_of( 1 ) == std::vector<std::string_view>{"write"} );
+
+  CHECK( !tokenizer.tokenize( "read \"abc" ) );
+  CHECK( tokens_of( 0 ) == std::vector<std::string_view>{"read", "\"abc"} );
+
+  CHECK( tokenizer.tokenize( "  strash   -v\t " ) );
+  CHECK( tokenizer.commands()[0].text == "strash   -v" );
+  CHECK( tokens_of( 0 ) == std::vector<std::string_view>{"strash", "-v"} );
+
+  CHECK( tokenizer.tokenize( "" ) );
+  CHECK( tokenizer.commands().empty() );
+}
+
+TEST_CASE( "split text into lines", "[utils]" )
+{
+  std::vector<std::string_view> lines;
+  for_each_line( "read\r\n\nwrite -v\nquit", [&]( std::string_view line ) { lines.push_back( line ); } );
+  CHECK( lines == std::vector<std::string_view>{"read\r", "", "write -v", "quit"} );
+
+  lines.clear();
+  for_each_line( "read\n", [&]( std::string_view line ) { lines.push_back( line ); } );
+  CHECK( lines == std::vector<std::string_view>{"read"} );
+}
+
+TEST_CASE( "match lines against aliases", "[utils]" )
+{
+  alias_matcher matcher;
+  std::string result;
+
+  CHECK( !matcher.expand( "read", result ) );
+
+  matcher.insert( "r (.*)", "read {}" );
+  matcher.insert( "ra?w (\\w+) (\\w+)", "write {1} {0}" );
+  matcher.insert( "(.*) -v", "{} --verbose" );
+
+  CHECK( matcher.expand( "r file.aig", result ) );
+  CHECK( result == "read file.aig" );
+  CHECK( matcher.expand( "rw a b", result ) );
+  CHECK( result == "write b a" );
+  CHECK( matcher.expand( "raw a b", result ) );
+  CHECK( result == "write b a" );
+  CHECK( matcher.expand( "ps -v", result ) );
+  CHECK( result == "ps --verbose" );
+
+  /* first matching alias in insertion order */
+  CHECK( matcher.expand( "r a -v", result ) );
+  CHECK( result == "read a -v" );
+
+  /* expansion can be changed */
+  matcher.insert( "r (.*)", "read_aiger {}" );
+  CHECK( matcher.expand( "r a", result ) );
+  CHECK( result == "read_aiger a" );
+
+  CHECK( !matcher.expand( "rx", result ) );
+  CHECK_THROWS_AS( matcher.insert( "(abc", "abc" ), std::regex_error );
+}
+
+TEST_CASE( "least recently used cache", "[utils]" )
+{
+  lru_cache<int> cache( 2u );
+
+  CHECK( cache.find( "a" ) == nullptr );
+  cache.insert( "a", 1 );
+  cache.insert( "b", 2 );
+  CHECK( *cache.find( "a" ) == 1 );
+
+  /* b is least recently used */
+  cache.insert( "c", 3 );
+  CHECK( cache.size() == 2u );
+  CHECK( cache.find( "b" ) == nullptr );
+  CHECK( *cache.find( "a" ) == 1 );
+  CHECK( *cache.find( "c" ) == 3 );
+
+  cache.insert( "c", 4 );
+  CHECK( *cache.find( "c" ) == 4 );
+  CHECK( cache.hits() == 4u );
+  CHECK( cache.misses() == 2u );
+
+  cache.clear();
+  CHECK( cache.size() == 0u );
+  CHECK( cache.find( "a" ) == nullptr );
+  CHECK( cache.misses() == 3u );
+}
+
+TEST_CASE( "substitute variables", "[utils]" )
+{
+  const std::unordered_map<std::string, std::string> variables = {{"a", "1"}, {"file", "x.aig"}, {"_b2", "z"}};
+
+  const auto subst = [&]( std::string_view text ) {
+    std::string result;
+    interpolation( text ).evaluate( variables, result );
+    return result;
+  };
+
+  CHECK( !has_variables( "read x.aig" ) );
+  CHECK( has_variables( "read $file" ) );
+
+  CHECK( subst( "$file" ) == "x.aig" );
+  CHECK( subst( "--n=$a" ) == "--n=1" );
+  CHECK( subst( "${a}0$_b2" ) == "10z" );
+  CHECK( subst( "$unknown." ) == "." );
+  CHECK( subst( "$$a $1 x$ ${}" ) == "$a $1 x$ ${}" );
+  CHECK( interpolation( "^foo$" ).size() == 0u );
+}
+
+TEST_CASE( "pass data through in-memory pipes", "[utils]" )
+{
+  pipe_buffer buffer;
+  std::ostream os( &buffer );
+  std::istream is( &buffer );
+
+  std::string line;
+  CHECK( !std::getline( is, line ) );
+  is.clear();
+
+  /* data that spans several chunks */
+  const std::string block( 3 * pipe_buffer::chunk_size / 2, 'x' );
+  os << block << "\nfirst\n";
+
+  CHECK( std::getline( is, line ) );
+  CHECK( line == block );
+  CHECK( std::getline( is, line ) );
+  CHECK( line == "first" );
+
+  /* reading continues after more has been written */
+  CHECK( !std::getline( is, line ) );
+  is.clear();
+  os << "second\n" << block;
+  CHECK( std::getline( is, line ) );
+  CHECK( line == "second" );
+  CHECK( std::getline( is, line ) );
+  CHECK( line == block );
+}
+
+TEST_CASE( "read lines in blocks", "[utils]" )
+{
+  auto* file = std::tmpfile();
+  std::fputs( "first\nsecond line\n\nlast without newline", file );
+  std::rewind( file );
+
+  /* lines that are longer than a block */
+  line_reader reader( file, 4u );
+  std::vector<std::string> lines;
+  std::string line;
+  while ( reader.read_line( line ) )
+  {
+    lines.push_back( line );
+  }
+  std::fclose( file );
+
+  CHECK( lines == std::vector<std::string>{"first", "second line", "", "last without newline"} );
+}